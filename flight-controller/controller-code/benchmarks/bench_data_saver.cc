@@ -0,0 +1,73 @@
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <DetectorSupport.hh>
+#include <HafxControl.hh>
+
+namespace {
+/*
+ * Handing science data to the UDP saver.  Nothing listens on the port,
+ * so this is the cost on our side of the socket only.
+ */
+constexpr unsigned short PORT = 61003;
+
+// Arg: bytes per add
+void BM_DataSaverAdd(benchmark::State& state) {
+    Detector::DataSaver ds{PORT};
+    std::string blob(state.range(0), 'x');
+    for (auto _ : state) {
+        ds.add(blob);
+    }
+    state.SetBytesProcessed(state.iterations() * blob.size());
+}
+
+/*
+ * One time slice at a time into the queue HafxControl uses, 32 per
+ * send.  Every 32nd add pays for the send.
+ */
+void BM_QueuedDataSaverAdd(benchmark::State& state) {
+    using msg_t = DetectorMessages::HafxNominalSpectrumStatus;
+    Detector::QueuedDataSaver<msg_t> qds{PORT, 32};
+
+    msg_t slice{};
+    uint32_t anchor = 1;
+    uint16_t n = 0;
+    for (auto _ : state) {
+        slice.buffer_number = n;
+        slice.time_anchor = (n == 0) ? anchor++ : 0;
+        n = (n + 1) % 32;
+        benchmark::DoNotOptimize(qds.add(slice));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * sizeof(msg_t));
+}
+
+/*
+ * The same, with each slice packed straight into the queue from its
+ * registers, as HafxControl::poll_save_time_slice does.
+ */
+void BM_QueuedDataSaverPackInPlace(benchmark::State& state) {
+    using msg_t = DetectorMessages::HafxNominalSpectrumStatus;
+    Detector::QueuedDataSaver<msg_t> qds{PORT, 32};
+
+    SipmUsb::FpgaTimeSlice raw{};
+    for (size_t i = 0; i < raw.registers.size(); ++i) {
+        raw.registers[i] = static_cast<uint16_t>(i * 31);
+    }
+    time_t anchor = 1;
+    uint16_t n = 0;
+    for (auto _ : state) {
+        raw.registers[0] = n;
+        n = (n + 1) % 32;
+        Detector::pack_time_slice(raw, anchor, qds.next_slot());
+        benchmark::DoNotOptimize(qds.commit_slot());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * sizeof(msg_t));
+}
+}
+
+BENCHMARK(BM_DataSaverAdd)->Arg(64)->Arg(sizeof(DetectorMessages::HafxNominalSpectrumStatus))->Arg(24576);
+BENCHMARK(BM_QueuedDataSaverAdd);
+BENCHMARK(BM_QueuedDataSaverPackInPlace);
@@ -0,0 +1,142 @@
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include <HafxControl.hh>
+#include <IoContainer.hh>
+#include <SimulatedSipm3k.hh>
+#include <UsbManager.hh>
+
+namespace {
+using namespace std::chrono_literals;
+
+/*
+ * Decoding what comes off the Bridgeport boards, on synthetic
+ * registers.  Time per iteration is one container; bytes_per_second
+ * counts the container bytes.
+ */
+template<typename ConT>
+void fill_random(ConT& con, uint32_t seed = 1) {
+    std::mt19937 rng{seed};
+    std::uniform_int_distribution<unsigned> byte{0, 255};
+    auto raw = reinterpret_cast<unsigned char*>(con.registers.data());
+    for (size_t i = 0; i < sizeof(con.registers); ++i) {
+        raw[i] = static_cast<unsigned char>(byte(rng));
+    }
+}
+
+void BM_TimeSliceDecode(benchmark::State& state) {
+    SipmUsb::FpgaTimeSlice ts;
+    fill_random(ts);
+    for (auto _ : state) {
+        auto dec = ts.decode();
+        benchmark::DoNotOptimize(dec);
+    }
+    state.SetBytesProcessed(state.iterations() * sizeof(ts));
+}
+
+// Arg: events in the bank, at most 2047
+void BM_NrlDecode(benchmark::State& state) {
+    auto nrl = std::make_unique<SipmUsb::FpgaLmNrl1>();
+    fill_random(*nrl);
+    // first slot is the header, so one more
+    nrl->registers[0] = static_cast<uint16_t>(state.range(0) + 1);
+    for (auto _ : state) {
+        auto events = nrl->decode();
+        benchmark::DoNotOptimize(events);
+    }
+    state.SetBytesProcessed(state.iterations() * sizeof(*nrl));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Same, into storage kept across calls
+void BM_NrlDecodeInto(benchmark::State& state) {
+    auto nrl = std::make_unique<SipmUsb::FpgaLmNrl1>();
+    fill_random(*nrl);
+    nrl->registers[0] = static_cast<uint16_t>(state.range(0) + 1);
+    auto out = std::make_unique<SipmUsb::NrlEventArray>();
+    for (auto _ : state) {
+        auto dec = nrl->decode_into(*out);
+        benchmark::DoNotOptimize(dec);
+    }
+    state.SetBytesProcessed(state.iterations() * sizeof(*nrl));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Arg: events in the buffer, at most 340
+void BM_ListModeParse(benchmark::State& state) {
+    SipmUsb::FpgaListMode lm;
+    fill_random(lm);
+    lm.registers[0] = static_cast<uint16_t>(state.range(0));
+    for (auto _ : state) {
+        auto events = lm.parse_list_buffer();
+        benchmark::DoNotOptimize(events);
+    }
+    state.SetBytesProcessed(state.iterations() * sizeof(lm));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// A time slice's registers packed for the science stream, by way of
+// DecodedTimeSlice
+void BM_TimeSlicePack(benchmark::State& state) {
+    SipmUsb::FpgaTimeSlice ts;
+    fill_random(ts);
+    ts.registers[0] = 0;
+    time_t anchor = 1;
+    for (auto _ : state) {
+        auto packed = Detector::pack_time_slice(ts.decode(), anchor);
+        benchmark::DoNotOptimize(packed);
+    }
+    state.SetBytesProcessed(
+        state.iterations() * sizeof(DetectorMessages::HafxNominalSpectrumStatus));
+}
+
+// The same straight from the registers, as poll_save_time_slice does
+void BM_TimeSlicePackRaw(benchmark::State& state) {
+    SipmUsb::FpgaTimeSlice ts;
+    fill_random(ts);
+    ts.registers[0] = 0;
+    time_t anchor = 1;
+    DetectorMessages::HafxNominalSpectrumStatus packed;
+    for (auto _ : state) {
+        Detector::pack_time_slice(ts, anchor, packed);
+        benchmark::DoNotOptimize(packed);
+    }
+    state.SetBytesProcessed(
+        state.iterations() * sizeof(DetectorMessages::HafxNominalSpectrumStatus));
+}
+
+/*
+ * HafxControl::poll_save_time_slice against a SimulatedSipm3k with a
+ * second's worth (32) of slices waiting: the whole read, decode, pack
+ * and queue path.  Saved data go to a UDP port nobody listens on.
+ */
+void BM_PollSaveTimeSlice(benchmark::State& state) {
+    auto sim = std::make_shared<SipmUsb::SimulatedSipm3k>(
+        SipmUsb::SimulatedSipm3kConfig{.manual_clock = true});
+    auto usb = std::make_shared<SipmUsb::UsbManager>(sim);
+    Detector::HafxControl ctrl{usb, Detector::DetectorPorts{.science = 61001, .debug = 61002}};
+    ctrl.restart_time_slice_or_histogram();
+    ctrl.data_time_anchor(1);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        sim->advance(1s);
+        state.ResumeTiming();
+        ctrl.poll_save_time_slice();
+    }
+    state.SetItemsProcessed(state.iterations() * 32);
+    state.SetBytesProcessed(state.iterations() * 32 * sizeof(SipmUsb::FpgaTimeSlice));
+}
+}
+
+BENCHMARK(BM_TimeSliceDecode);
+BENCHMARK(BM_NrlDecode)->Arg(64)->Arg(512)->Arg(2047);
+BENCHMARK(BM_NrlDecodeInto)->Arg(64)->Arg(512)->Arg(2047);
+BENCHMARK(BM_ListModeParse)->Arg(32)->Arg(340);
+BENCHMARK(BM_TimeSlicePack);
+BENCHMARK(BM_TimeSlicePackRaw);
+BENCHMARK(BM_PollSaveTimeSlice)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,53 @@
+#include <chrono>
+#include <variant>
+
+#include <benchmark/benchmark.h>
+
+#include <DetectorService.hh>
+
+namespace {
+namespace dm = DetectorMessages;
+
+using namespace std::chrono_literals;
+
+// How the queue message looked before large settings were boxed:
+// every alternative takes up as much room as the 64 KiB X-123 settings.
+using InlineMessage = std::variant<
+    dm::Initialize,
+    dm::HafxSettings,
+    dm::X123Settings,
+    dm::CollectNominal,
+    dm::StartNrlList
+>;
+
+// One NRL poll tick: push then pop, the way evt_loop_step sees it.
+template<typename MessageT>
+void BM_QueuePushPop(benchmark::State& state) {
+    ThreadSafeQueue<MessageT> queue;
+    for (auto _ : state) {
+        queue.push(dm::StartNrlList{.started = true});
+        auto msg = queue.pop();
+        benchmark::DoNotOptimize(msg);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["message_bytes"] = sizeof(MessageT);
+}
+
+// Same, but through the timer path used to re-arm the polling loops.
+template<typename MessageT>
+void BM_QueuePushDelayPop(benchmark::State& state) {
+    ThreadSafeQueue<MessageT> queue;
+    for (auto _ : state) {
+        queue.push_delay(dm::StartNrlList{.started = true}, 0ms);
+        auto msg = queue.pop();
+        benchmark::DoNotOptimize(msg);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["message_bytes"] = sizeof(MessageT);
+}
+}
+
+BENCHMARK_TEMPLATE(BM_QueuePushPop, InlineMessage);
+BENCHMARK_TEMPLATE(BM_QueuePushPop, DetectorService::Message);
+BENCHMARK_TEMPLATE(BM_QueuePushDelayPop, InlineMessage);
+BENCHMARK_TEMPLATE(BM_QueuePushDelayPop, DetectorService::Message);
@@ -0,0 +1,148 @@
+#include <array>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <DetectorSupport.hh>
+#include <IoContainer.hh>
+#include <NrlScan.hh>
+
+namespace {
+/*
+ * Saving one full NRL bank (2047 events), from the registers USB filled
+ * to the UDP socket.  Nothing listens on the port.
+ *
+ * bytes_copied counts what we copy in user space per bank; the socket's
+ * own copy into the kernel is the same for both and isn't counted.
+ */
+constexpr unsigned short PORT = 61004;
+
+std::unique_ptr<SipmUsb::FpgaLmNrl1> full_bank() {
+    auto nrl = std::make_unique<SipmUsb::FpgaLmNrl1>();
+    std::mt19937 rng{1};
+    for (auto& r : nrl->registers) {
+        r = static_cast<uint16_t>(rng());
+    }
+    nrl->registers[0] = 2048;
+    return nrl;
+}
+
+// How HafxControl::poll_save_nrl_list used to do it
+void BM_NrlSaveCopying(benchmark::State& state) {
+    Detector::DataSaver ds{PORT};
+    auto nrl = full_bank();
+    size_t copied = 0;
+
+    for (auto _ : state) {
+        // each event memcpy'd into a vector
+        auto data = nrl->decode();
+        bool has_pps = false;
+        for (const auto& d : data) {
+            has_pps = has_pps || d.was_pps;
+        }
+        benchmark::DoNotOptimize(has_pps);
+        size_t evt_bytes = data.size() * sizeof(SipmUsb::NrlListDataPoint);
+
+        // into a string, then two concatenations
+        auto evts_save = std::string{reinterpret_cast<const char*>(data.data()), evt_bytes};
+        uint16_t len = static_cast<uint16_t>(data.size());
+        uint32_t now = static_cast<uint32_t>(time(NULL));
+        auto size_save = std::string{reinterpret_cast<const char*>(&len), sizeof(len)};
+        auto timestamp_save = std::string{reinterpret_cast<const char*>(&now), sizeof(now)};
+        auto joined = size_save + evts_save + timestamp_save;
+
+        // and DataSaver::add copied it into a vector before sendto
+        std::vector<char> to_send(joined.begin(), joined.end());
+        ds.add(to_send);
+
+        auto total = sizeof(len) + evt_bytes + sizeof(now);
+        copied = evt_bytes             // decode
+            + evt_bytes                // evts_save
+            + (sizeof(len) + evt_bytes) // size_save + evts_save
+            + total                    // ... + timestamp_save
+            + total;                   // to_send
+    }
+    state.SetBytesProcessed(state.iterations() * nrl->event_bytes().size());
+    state.counters["bytes_copied"] = static_cast<double>(copied);
+}
+
+// What it does now: header, events and timestamp gathered by sendmsg
+void BM_NrlSaveGather(benchmark::State& state) {
+    Detector::DataSaver ds{PORT};
+    auto nrl = full_bank();
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(SipmUsb::scan_nrl_flags(nrl->event_bytes()));
+        uint16_t len = static_cast<uint16_t>(nrl->num_events());
+        uint32_t now = static_cast<uint32_t>(time(NULL));
+        ds.add_gather({
+            Detector::bytes_of(len),
+            nrl->event_bytes(),
+            Detector::bytes_of(now)
+        });
+    }
+    state.SetBytesProcessed(state.iterations() * nrl->event_bytes().size());
+    state.counters["bytes_copied"] = 0;
+}
+
+/*
+ * Looking for PPS markers in a full bank: the early-out has_pps check,
+ * a full pass over the decoded events, and the flag scan (which counts
+ * every flag and finds every PPS besides).  PPS markers sit at the end
+ * of the bank, the worst case for the early out.
+ */
+std::unique_ptr<SipmUsb::FpgaLmNrl1> bank_with_late_pps() {
+    auto nrl = full_bank();
+    auto events = nrl->decode();
+    for (auto& e : events) {
+        e.was_pps = 0;
+    }
+    events.back().was_pps = 1;
+    std::memcpy(nrl->registers.data() + 6, events.data(), events.size() * sizeof(events[0]));
+    return nrl;
+}
+
+void BM_NrlHasPps(benchmark::State& state) {
+    auto nrl = bank_with_late_pps();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(nrl->has_pps());
+    }
+    state.SetBytesProcessed(state.iterations() * nrl->event_bytes().size());
+}
+
+void BM_NrlFlagsDecoded(benchmark::State& state) {
+    auto nrl = bank_with_late_pps();
+    for (auto _ : state) {
+        SipmUsb::NrlFlagCounts counts{};
+        for (auto const& e : nrl->decode()) {
+            counts.pps += e.was_pps;
+            counts.external_trigger += e.external_trigger;
+            counts.piled_up += e.piled_up;
+            counts.sum_overflow += e.sum_overflow;
+            counts.out_of_range += e.out_of_range;
+        }
+        benchmark::DoNotOptimize(counts);
+    }
+    state.SetBytesProcessed(state.iterations() * nrl->event_bytes().size());
+}
+
+void BM_NrlFlagScan(benchmark::State& state) {
+    auto nrl = bank_with_late_pps();
+    std::array<uint16_t, 16> pps;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(SipmUsb::scan_nrl_flags(nrl->event_bytes(), pps));
+    }
+    state.SetBytesProcessed(state.iterations() * nrl->event_bytes().size());
+}
+}
+
+BENCHMARK(BM_NrlSaveCopying)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_NrlSaveGather)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_NrlHasPps)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_NrlFlagsDecoded)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_NrlFlagScan)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,56 @@
+#include <atomic>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+#include <DetectorService.hh>
+#include "legacy_thread_safe_queue.hh"
+
+namespace {
+namespace dm = DetectorMessages;
+
+/*
+ * The service thread pops while two producers push at the same time:
+ * one standing in for the Listener thread (ground commands) and one
+ * for the timer thread (polling ticks).  Producers keep at most
+ * MAX_OUTSTANDING messages queued so both implementations are measured
+ * at the same queue depth.
+ */
+template<template<typename> class QueueT>
+void BM_QueueContended(benchmark::State& state) {
+    constexpr int MAX_OUTSTANDING = 64;
+    QueueT<DetectorService::Message> queue;
+    std::atomic<int> outstanding{0};
+    std::atomic<bool> stop{false};
+
+    auto producer = [&](auto make_message) {
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (outstanding.load(std::memory_order_relaxed) >= MAX_OUTSTANDING) {
+                std::this_thread::yield();
+                continue;
+            }
+            outstanding.fetch_add(1, std::memory_order_relaxed);
+            queue.push(make_message());
+        }
+    };
+    std::thread listener{producer, []() { return dm::StopNominal{}; }};
+    std::thread timer{producer, []() { return dm::StartNrlList{.started = true}; }};
+
+    for (auto _ : state) {
+        auto msg = queue.pop();
+        outstanding.fetch_sub(1, std::memory_order_relaxed);
+        benchmark::DoNotOptimize(msg);
+    }
+
+    stop = true;
+    listener.join();
+    timer.join();
+    // drain so the producers' last pushes don't outlive the queue
+    while (queue.pop_timeout(std::chrono::milliseconds{0}));
+
+    state.SetItemsProcessed(state.iterations());
+}
+}
+
+BENCHMARK_TEMPLATE(BM_QueueContended, LegacyThreadSafeQueue)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_QueueContended, ThreadSafeQueue)->UseRealTime();
@@ -0,0 +1,70 @@
+#include <chrono>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <DetectorService.hh>
+#include "legacy_thread_safe_queue.hh"
+
+namespace {
+namespace dm = DetectorMessages;
+using namespace std::chrono_literals;
+
+/*
+ * Arm a polling timer and cancel it again (what StopNrlList/StopNominal
+ * and every re-arm of a TimerLifetime do) while state.range(0) other
+ * timers are pending, like the nominal, health and debug timers.
+ */
+void BM_LegacyTimerArmCancel(benchmark::State& state) {
+    LegacyThreadSafeQueue<DetectorService::Message> queue;
+    std::vector<std::shared_ptr<PushDelayTimer>> background;
+    for (int i = 0; i < state.range(0); ++i) {
+        background.push_back(queue.push_delay(dm::StopNominal{}, 1h));
+    }
+
+    for (auto _ : state) {
+        auto timer = queue.push_delay(dm::StartNrlList{.started = true}, 23ms);
+        timer->cancel();
+        // a cancelled asio timer still has to be run off the context
+        timer->boost_timer().cancel();
+        queue.pop_timeout(0ms);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_TimerArmCancel(benchmark::State& state) {
+    ThreadSafeQueue<DetectorService::Message> queue;
+    std::vector<TimerLifetime> background;
+    for (int i = 0; i < state.range(0); ++i) {
+        background.emplace_back(queue.push_delay(dm::StopNominal{}, 1h));
+    }
+
+    for (auto _ : state) {
+        auto timer = TimerLifetime{
+            queue.push_delay(dm::StartNrlList{.started = true}, 23ms)
+        };
+        timer.reset();
+        queue.pop_timeout(0ms);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Bare wheel cost, without the queue's locking and clock reads.
+void BM_TimerWheelArmCancel(benchmark::State& state) {
+    auto now = TimerWheel<int>::clock::now();
+    TimerWheel<int> wheel{now};
+    for (int i = 0; i < state.range(0); ++i) {
+        wheel.arm(i, now + 1h);
+    }
+
+    for (auto _ : state) {
+        auto h = wheel.arm(-1, now + 23ms);
+        benchmark::DoNotOptimize(wheel.cancel(h));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+}
+
+BENCHMARK(BM_LegacyTimerArmCancel)->Arg(0)->Arg(8)->Arg(64);
+BENCHMARK(BM_TimerArmCancel)->Arg(0)->Arg(8)->Arg(64);
+BENCHMARK(BM_TimerWheelArmCancel)->Arg(0)->Arg(8)->Arg(64);
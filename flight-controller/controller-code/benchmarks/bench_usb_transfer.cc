@@ -0,0 +1,66 @@
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include <IoContainer.hh>
+#include <UsbManager.hh>
+
+namespace {
+/*
+ * Needs a Bridgeport board plugged in (the first one found is used);
+ * otherwise every case is skipped.
+ *
+ * Arg is the pipeline depth: 0 is the synchronous path, one blocking
+ * libusb_bulk_transfer per 256-byte chunk.  Time per iteration is the
+ * latency of one container read, and bytes_per_second is throughput.
+ */
+std::shared_ptr<SipmUsb::UsbManager> first_device() {
+    static auto manager = std::make_unique<SipmUsb::BridgeportDeviceManager>();
+    if (manager->device_map.empty()) {
+        return nullptr;
+    }
+    return manager->device_map.begin()->second;
+}
+
+template<typename ContainerT>
+void BM_UsbRead(benchmark::State& state) {
+    std::shared_ptr<SipmUsb::UsbManager> dev;
+    try {
+        dev = first_device();
+    } catch (const std::exception& e) {
+        state.SkipWithError(e.what());
+        return;
+    }
+    if (!dev) {
+        state.SkipWithError("no Bridgeport device connected");
+        return;
+    }
+
+    auto depth = static_cast<size_t>(state.range(0));
+    if (depth == 0) {
+        dev->transfer_mode(SipmUsb::TransferMode::synchronous);
+    }
+    else {
+        dev->transfer_mode(SipmUsb::TransferMode::pipelined, depth);
+    }
+
+    ContainerT con;
+    for (auto _ : state) {
+        dev->read(con, SipmUsb::MemoryType::ram);
+        benchmark::DoNotOptimize(con);
+    }
+    dev->transfer_mode(SipmUsb::TransferMode::synchronous);
+
+    state.SetBytesProcessed(state.iterations() * sizeof(ContainerT));
+    state.counters["container_bytes"] = sizeof(ContainerT);
+}
+}
+
+BENCHMARK_TEMPLATE(BM_UsbRead, SipmUsb::FpgaLmNrl1)
+    ->Arg(0)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_UsbRead, SipmUsb::FpgaHistogram)
+    ->Arg(0)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_UsbRead, SipmUsb::FpgaTimeSlice)
+    ->Arg(0)->Arg(4)->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_UsbRead, SipmUsb::FpgaResults)
+    ->Arg(0)->Arg(4)->UseRealTime()->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,89 @@
+#include <random>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <CharCast.hh>
+#include <X123Control.hh>
+
+namespace {
+namespace req = X123Driver::Packets::Requests;
+namespace res = X123Driver::Packets::Responses;
+
+std::vector<uint8_t> random_bytes(size_t n, uint32_t seed = 1) {
+    std::mt19937 rng{seed};
+    std::uniform_int_distribution<unsigned> byte{0, 255};
+    std::vector<uint8_t> ret(n);
+    for (auto& b : ret) {
+        b = static_cast<uint8_t>(byte(rng));
+    }
+    return ret;
+}
+
+// A spectrum + status reply with random contents, packed and ready to
+// be received.
+class RandomSpectrum : public res::BaseSpectrum {
+public:
+    explicit RandomSpectrum(size_t bins) :
+        BaseSpectrum(bins, 0x81_ch, 0x06_ch)
+    {
+        parsed = random_bytes(parsed.size());
+        transferFromParsed();
+    }
+};
+
+// Arg: number of bins
+void BM_AssembleSpectrum(benchmark::State& state) {
+    auto raw = random_bytes(3 * state.range(0));
+    for (auto _ : state) {
+        auto spec = Detector::assemble_spectrum(raw);
+        benchmark::DoNotOptimize(spec);
+    }
+    state.SetBytesProcessed(state.iterations() * raw.size());
+}
+
+// Args: number of bins, number of rebin edges
+void BM_RebinSpectrum(benchmark::State& state) {
+    size_t bins = state.range(0);
+    size_t num_edges = state.range(1);
+    auto spec = Detector::assemble_spectrum(random_bytes(3 * bins));
+
+    DetectorMessages::X123Settings settings{};
+    settings.adc_rebin_edges_length = static_cast<uint16_t>(num_edges);
+    for (size_t i = 0; i < num_edges; ++i) {
+        settings.adc_rebin_edges[i] = static_cast<uint32_t>(i * bins / (num_edges - 1));
+    }
+
+    for (auto _ : state) {
+        auto rebinned = Detector::rebin_spectrum(spec, settings);
+        benchmark::DoNotOptimize(rebinned);
+    }
+    state.SetBytesProcessed(state.iterations() * bins * sizeof(uint32_t));
+}
+
+// Packing a request: header, copy, checksum.  Arg: settings string length
+void BM_TransferFromParsed(benchmark::State& state) {
+    req::TextConfigurationToRam tconf{std::string(state.range(0), 'A')};
+    for (auto _ : state) {
+        tconf.transferFromParsed();
+        benchmark::DoNotOptimize(tconf.transferPointer());
+    }
+    state.SetBytesProcessed(state.iterations() * tconf.transferSize());
+}
+
+// Checking (sync, PID, checksum, size) and unpacking a reply.
+// Arg: number of bins
+void BM_ParsedFromTransfer(benchmark::State& state) {
+    RandomSpectrum spec{static_cast<size_t>(state.range(0))};
+    for (auto _ : state) {
+        spec.parsedFromTransfer();
+        benchmark::DoNotOptimize(spec.parsedBuffer().data());
+    }
+    state.SetBytesProcessed(state.iterations() * spec.transferSize());
+}
+}
+
+BENCHMARK(BM_AssembleSpectrum)->Arg(256)->Arg(1024)->Arg(8192);
+BENCHMARK(BM_RebinSpectrum)->Args({1024, 2})->Args({1024, 128})->Args({8192, 128});
+BENCHMARK(BM_TransferFromParsed)->Arg(64)->Arg(512);
+BENCHMARK(BM_ParsedFromTransfer)->Arg(256)->Arg(1024)->Arg(8192);
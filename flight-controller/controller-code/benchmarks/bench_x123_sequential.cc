@@ -0,0 +1,54 @@
+#include <chrono>
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include <SimulatedX123.hh>
+#include <X123Control.hh>
+
+namespace {
+using namespace std::chrono_literals;
+
+/*
+ * X123Control::read_save_sequential_buffer against a SimulatedX123
+ * running hardware-controlled sequential buffering.  The simulated
+ * X-123 is let run state.range(0) seconds (buffers) ahead, so the read
+ * has to catch up through all of them, the way it does after a missed
+ * nominal poll.  state.range(1) is the latency of every USB transfer,
+ * in microseconds.
+ *
+ * Spectra go to a UDP port nobody listens on.
+ */
+void BM_X123SequentialCatchUp(benchmark::State& state) {
+    auto behind = state.range(0);
+    auto sim = std::make_shared<X123Driver::SimulatedX123>(X123Driver::SimulatedX123Config{
+        .count_rate = 2000,
+        .buffer_advance = 1s,
+        .manual_clock = true,
+        .transfer_latency = std::chrono::microseconds{state.range(1)},
+    });
+    Detector::X123Control ctrl{
+        Detector::DetectorPorts{.science = 61001, .debug = 61002},
+        std::make_unique<X123DriverWrap>(sim)
+    };
+    ctrl.data_time_anchor(1);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        ctrl.restart_hardware_controlled_sequential_buffering();
+        // waits for buffer 0
+        ctrl.read_save_sequential_buffer();
+        sim->advance(std::chrono::seconds{behind} + 500ms);
+        state.ResumeTiming();
+
+        ctrl.read_save_sequential_buffer();
+    }
+    // the newest full buffer waits for the next poll
+    state.SetItemsProcessed(state.iterations() * (behind - 1));
+}
+}
+
+BENCHMARK(BM_X123SequentialCatchUp)
+    ->Args({2, 0})->Args({8, 0})->Args({64, 0})
+    ->Args({2, 200})->Args({8, 200})
+    ->UseRealTime()->Unit(benchmark::kMicrosecond);
@@ -83,6 +83,39 @@ setup_service(int sock_fd) {
         detp{port_env("X123_SCI_PORT"), port_env("X123_DBG_PORT")}
     );
 
+    // optional; synchronous USB transfers if unset
+    if (auto depth = std::getenv("HAFX_USB_PIPELINE_DEPTH")) {
+        service->put_hafx_usb_pipeline_depth(std::atoi(depth));
+    }
+
+    // optional; 16-bit time slices, about half the size
+    if (auto compact = std::getenv("HAFX_COMPACT_SLICES"); compact && std::atoi(compact)) {
+        service->put_hafx_time_slice_format(Detector::TimeSliceFormat::compact);
+    }
+
+    // optional; how long a poll waits on a stalled detector
+    if (auto budget = std::getenv("DET_POLL_BUDGET_MS")) {
+        service->put_poll_budget(std::chrono::milliseconds{std::atoi(budget)});
+    }
+
+    // optional; bounds on the NRL poll period, which otherwise
+    // follows the count rate
+    auto nrl_min = std::getenv("NRL_POLL_MIN_MS");
+    auto nrl_max = std::getenv("NRL_POLL_MAX_MS");
+    if (nrl_min && nrl_max) {
+        service->put_nrl_poll_bounds(
+            std::chrono::milliseconds{std::atoi(nrl_min)},
+            std::chrono::milliseconds{std::atoi(nrl_max)});
+    }
+
+    // drop and pick up detectors as they're unplugged and plugged in
+    try {
+        auto usb_ctx = std::make_shared<LibUsbCpp::Context>();
+        service->watch_hotplug(std::make_unique<LibUsbCpp::Hotplug>(usb_ctx));
+    } catch (const LibUsbCpp::UsbException& e) {
+        log_warning("no USB hotplug events: " + std::string{e.what()});
+    }
+
     return service;
 }
 
@@ -6,6 +6,7 @@
 #include <array>
 #include <ctime>
 #include <future>
+#include <memory>
 #include <optional>
 #include <variant>
 #include <vector>
@@ -103,6 +104,15 @@ namespace DetectorMessages {
     };
     struct StopNrlList { };
 
+    // a USB device was plugged in or unplugged (from libusb hotplug)
+    struct UsbHotplug {
+        bool arrived;
+        uint16_t vendor_id;
+        uint16_t product_id;
+        uint8_t bus;
+        uint8_t address;
+    };
+
     struct __attribute__((packed)) HafxHealth {
         // 0.01K / tick
         uint16_t arm_temp;
@@ -150,10 +160,29 @@ namespace DetectorMessages {
     struct StartPeriodicHealth {
         uint32_t seconds_between;
         std::vector<sockaddr_in> fwd;
+        bool started = false;
     };
 
     struct StopPeriodicHealth { };
 
+    /*
+     * Keeps a large, rarely-sent payload (like the 64 KiB X-123 settings)
+     * out of line so the command variants stay a few dozen bytes.
+     * The payload is immutable and reference-counted, so copying or
+     * moving a Boxed<T> through the command queue and timer callbacks
+     * only copies a pointer.
+     */
+    template<typename T>
+    class Boxed {
+        std::shared_ptr<const T> payload;
+    public:
+        Boxed(T&& t) : payload{std::make_shared<const T>(std::move(t))} { }
+        Boxed(T const& t) : payload{std::make_shared<const T>(t)} { }
+
+        T const& operator*() const { return *payload; }
+        T const* operator->() const { return payload.get(); }
+    };
+
     using DetectorCommand = std::variant<
         Initialize,
         Shutdown,
@@ -161,8 +190,8 @@ namespace DetectorMessages {
         StopNominal,
         StartNrlList,
         StopNrlList,
-        X123Settings,
-        HafxSettings,
+        Boxed<X123Settings>,
+        Boxed<HafxSettings>,
         HafxDebug,
         X123Debug,
         StartPeriodicHealth,
@@ -187,4 +216,28 @@ namespace DetectorMessages {
         uint32_t time_anchor;
         bool missed_pps;
     };
+
+    // HafxNominalSpectrumStatus at the widths the board gives them (16
+    // bits), about half the size.  Sent in its place when compact time
+    // slices are turned on.  `version` comes first and is never a
+    // HafxChannel, so a reader can tell the two apart.
+    struct __attribute__((packed)) HafxCompactSpectrumStatus {
+        static constexpr uint8_t VERSION_1 = 0x81;
+
+        uint8_t version;
+        uint8_t ch;
+        uint16_t buffer_number;
+        uint16_t num_evts;
+        uint16_t num_triggers;
+        uint16_t dead_time;
+        uint16_t anode_current;
+        uint16_t histogram[123];
+
+        uint32_t time_anchor;
+        bool missed_pps;
+        // Some slices before this one were lost on the board.  Only
+        // this format has room for it: nominal slices keep their
+        // layout, and losses show up in the logs instead.
+        bool slices_lost;
+    };
 }
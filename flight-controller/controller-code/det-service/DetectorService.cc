@@ -10,6 +10,58 @@ namespace dm = DetectorMessages;
 using hafx_chan = dm::HafxChannel;
 
 using namespace std::chrono_literals;
+
+// Periodic work is phased this far after the PPS edge
+// so it doesn't run right on top of a second tick.
+constexpr auto PPS_OFFSET = 317ms;
+
+// Default for how long one poll may wait on a device
+constexpr auto DEFAULT_POLL_BUDGET = 500ms;
+
+std::string hafx_name(hafx_chan ch) {
+    switch (ch) {
+        case hafx_chan::C1: return "HaFX C1";
+        case hafx_chan::M1: return "HaFX M1";
+        case hafx_chan::M5: return "HaFX M5";
+        case hafx_chan::X1: return "HaFX X1";
+    }
+    return "HaFX";
+}
+}
+
+namespace {
+using Priority = DetectorService::Priority;
+
+template<typename Cmd>
+Priority priority_of(Cmd const&) { return Priority::Command; }
+
+Priority priority_of(dm::CollectNominal const& c) {
+    return c.started ? Priority::Science : Priority::Command;
+}
+Priority priority_of(dm::ImmediateHafxTimeSliceRead const&) {
+    return Priority::Science;
+}
+Priority priority_of(dm::StartNrlList const& c) {
+    return c.started ? Priority::Science : Priority::Command;
+}
+Priority priority_of(dm::StartPeriodicHealth const& c) {
+    return c.started ? Priority::Housekeeping : Priority::Command;
+}
+Priority priority_of(dm::HafxDebug const&) { return Priority::Housekeeping; }
+Priority priority_of(dm::X123Debug const&) { return Priority::Housekeeping; }
+Priority priority_of(dm::QueryListMode const&) { return Priority::Housekeeping; }
+Priority priority_of(dm::QueryTraceAcquisition const&) { return Priority::Housekeeping; }
+Priority priority_of(dm::QueryLegacyHistogram const&) { return Priority::Housekeeping; }
+Priority priority_of(dm::QueryX123DebugHistogram const&) { return Priority::Housekeeping; }
+Priority priority_of(dm::PromiseWrap const& p) {
+    // ranked by what's inside
+    return std::visit([](auto const& m) { return priority_of(m); }, p.wrap_msg);
+}
+}
+
+size_t DetectorService::MessagePriority::operator()(Message const& m) const {
+    auto p = std::visit([](auto const& c) { return priority_of(c); }, m);
+    return static_cast<size_t>(p);
 }
 
 DetectorService::DetectorService(int socket_fd) :
@@ -18,9 +70,20 @@ DetectorService::DetectorService(int socket_fd) :
     x123_ports{},
     hafx_ports{},
     queue{},
+    hotplug{},
     x123_ctrl{nullptr},
     hafx_ctrl{},
-    hafx_serial_nums{}
+    hafx_serial_nums{},
+    hafx_locations{},
+    hafx_usb_pipeline_depth{0},
+    hafx_slice_format{Detector::TimeSliceFormat::nominal},
+    hafx_pollers{},
+    x123_poller{std::make_unique<DevicePoller>("X-123")},
+    poll_budget{DEFAULT_POLL_BUDGET},
+    nrl_poll_config{},
+    nrl_poll_rates{},
+    nrl_poll_due{},
+    slice_drain{}
 { }
 
 void DetectorService::put_hafx_ports(
@@ -37,7 +100,51 @@ void DetectorService::put_hafx_serial_nums(
     hafx_serial_nums = nums;
 }
 
-DetectorService::~DetectorService() { }
+void DetectorService::put_hafx_usb_pipeline_depth(size_t depth) {
+    hafx_usb_pipeline_depth = depth;
+}
+
+void DetectorService::put_poll_budget(std::chrono::milliseconds budget) {
+    poll_budget = budget;
+}
+
+void DetectorService::put_hafx_time_slice_format(Detector::TimeSliceFormat format) {
+    hafx_slice_format = format;
+}
+
+void DetectorService::put_nrl_poll_bounds(
+    std::chrono::milliseconds min, std::chrono::milliseconds max) {
+    nrl_poll_config.min_period = min;
+    nrl_poll_config.max_period = std::max(min, max);
+    nrl_poll_config.initial_period = std::clamp(
+        nrl_poll_config.initial_period, min, nrl_poll_config.max_period);
+}
+
+void DetectorService::watch_hotplug(std::unique_ptr<LibUsbCpp::HotplugSource> source) {
+    hotplug = std::move(source);
+
+    auto forward = [this](LibUsbCpp::HotplugEvent const& e) {
+        push_message(dm::UsbHotplug{
+            .arrived = (e.kind == LibUsbCpp::HotplugEvent::Kind::arrived),
+            .vendor_id = e.vendor_id,
+            .product_id = e.product_id,
+            .bus = e.location.bus,
+            .address = e.location.address,
+        });
+    };
+    using x123_usb = X123Driver::UsbConnectionManager;
+    hotplug->watch(
+        SipmUsb::BridgeportDeviceManager::BRIDGEPORT_VID,
+        LibUsbCpp::HotplugSource::MATCH_ANY,
+        forward
+    );
+    hotplug->watch(x123_usb::AMPTEK_VENDOR_ID, x123_usb::AMPTEK_PRODUCT_ID, forward);
+}
+
+DetectorService::~DetectorService() {
+    // background polls refer to the detector objects
+    drain_pollers();
+}
 
 void DetectorService::run() {
     while (true) {
@@ -53,9 +160,10 @@ void DetectorService::evt_loop_step() {
             }
             catch (const ReconnectDetectors& e) {
                 // this will get caught if we have a timeout or other USB error
+                // from the X-123 (HaFX poll errors go to their circuit breakers)
                 // TODO add flag that we had a communication issue in health packet
-                log_error("Reconnecting detectors: " + std::string{e.what()});
-                reconnect_detectors();
+                log_error("Reconnecting X-123: " + std::string{e.what()});
+                reconnect_x123();
             }
         }
         catch (const std::exception& e) {
@@ -71,6 +179,41 @@ void DetectorService::evt_loop_step() {
     std::visit(cmd_visitor, std::move(command));
 }
 
+template<typename Cmd>
+TimerLifetime DetectorService::schedule_periodic(
+    Cmd cmd,
+    std::chrono::milliseconds period,
+    std::optional<std::chrono::steady_clock::time_point> pps
+) {
+    auto now = std::chrono::steady_clock::now();
+    auto first = now + period;
+    if (pps) {
+        // first tick on the PPS-phased grid that's still ahead of us
+        auto phase = *pps + PPS_OFFSET;
+        auto ticks_past = (now > phase) ? (now - phase) / period + 1 : 0;
+        first = phase + ticks_past * period;
+    }
+
+    return TimerLifetime{queue.push_periodic(
+        [cmd]() -> Message { return cmd; },
+        first,
+        period
+    )};
+}
+
+void DetectorService::report_overruns(TimerLifetime& timer, const std::string& what) {
+    report_overruns(timer.take_overruns(), what);
+}
+
+void DetectorService::report_overruns(uint64_t missed, const std::string& what) {
+    if (missed) {
+        log_warning(
+            what + " polling fell behind; skipped " +
+            std::to_string(missed) + " tick(s)"
+        );
+    }
+}
+
 void DetectorService::handle_command(dm::PromiseWrap msg) {
     auto p = std::move(msg.prom);
     try {
@@ -93,10 +236,15 @@ void DetectorService::handle_command(dm::Initialize) {
 }
 
 void DetectorService::reconnect_detectors() {
+    // nothing may still be talking to the old devices
+    drain_pollers();
+
     // HaFX detectors (scintillators)
     hafx_ctrl.clear();
+    hafx_locations.clear();
 
-    auto bridgeport_device_manager = std::make_shared<SipmUsb::BridgeportDeviceManager>();
+    auto bridgeport_device_manager = std::make_shared<SipmUsb::BridgeportDeviceManager>(
+        hafx_usb_pipeline_depth);
 
     for (const auto& [chan, sn] : hafx_serial_nums) {
         if (!bridgeport_device_manager->device_map.contains(sn)) {
@@ -107,21 +255,133 @@ void DetectorService::reconnect_detectors() {
             );
             continue;
         }
+        // fresh connection, fresh circuit breaker
+        hafx_pollers[chan] = std::make_unique<DevicePoller>(hafx_name(chan));
         try {
-            hafx_ctrl[chan] = std::make_unique<Detector::HafxControl>(
-                bridgeport_device_manager->device_map[sn],
-                hafx_ports[chan]
-            );
+            hafx_ctrl[chan] = make_hafx(chan, bridgeport_device_manager->device_map[sn]);
         } catch (const std::runtime_error& e) {
             push_message(dm::Shutdown{});
             throw DetectorException{std::string{"making hafx control: "} + e.what()};
         }
+        note_hafx_location(chan);
     }
 
     // X-123
     // release the resource before re-making it
     x123_ctrl.reset();
     x123_ctrl = std::make_unique<Detector::X123Control>(x123_ports);
+    x123_poller = std::make_unique<DevicePoller>("X-123");
+}
+
+void DetectorService::reconnect_x123() {
+    x123_poller->drain();
+    if (!x123_ctrl) {
+        return;
+    }
+    try {
+        x123_ctrl->reconnect();
+    } catch (const DetectorException& e) {
+        log_warning(e.what());
+    }
+}
+
+std::unique_ptr<Detector::HafxControl> DetectorService::make_hafx(
+    dm::HafxChannel chan, std::shared_ptr<SipmUsb::UsbManager> device)
+{
+    auto ctrl = std::make_unique<Detector::HafxControl>(device, hafx_ports[chan]);
+    ctrl->science_channel(chan);
+    ctrl->time_slice_format(hafx_slice_format);
+    return ctrl;
+}
+
+void DetectorService::attach_missing_hafx() {
+    // boards we already hold are skipped
+    SipmUsb::BridgeportDeviceManager found{hafx_usb_pipeline_depth};
+
+    for (const auto& [chan, sn] : hafx_serial_nums) {
+        if (hafx_ctrl.contains(chan) || !found.device_map.contains(sn)) {
+            continue;
+        }
+        try {
+            hafx_pollers[chan] = std::make_unique<DevicePoller>(hafx_name(chan));
+            hafx_ctrl[chan] = make_hafx(chan, found.device_map[sn]);
+        } catch (const std::runtime_error& e) {
+            log_warning(hafx_name(chan) + " attach: " + e.what());
+            continue;
+        }
+        note_hafx_location(chan);
+        log_info(hafx_name(chan) + " attached; it takes data from the next start");
+    }
+}
+
+void DetectorService::handle_command(dm::UsbHotplug cmd) {
+    // before Initialize there's nothing to update;
+    // it'll find whatever is plugged in
+    if (!_alive) {
+        return;
+    }
+
+    using x123_usb = X123Driver::UsbConnectionManager;
+    if (cmd.vendor_id == x123_usb::AMPTEK_VENDOR_ID
+        && cmd.product_id == x123_usb::AMPTEK_PRODUCT_ID) {
+        // there's only the one, and its retry reconnects it
+        if (cmd.arrived) {
+            x123_poller->device_arrived();
+        }
+        else {
+            x123_poller->device_left();
+        }
+        return;
+    }
+
+    if (cmd.vendor_id != SipmUsb::BridgeportDeviceManager::BRIDGEPORT_VID) {
+        return;
+    }
+
+    if (cmd.arrived) {
+        // can't tell which board it is without claiming it, so let any
+        // quarantined ones retry (which reconnects them)
+        for (auto& [_, poller] : hafx_pollers) {
+            poller->device_arrived();
+        }
+        try {
+            attach_missing_hafx();
+        } catch (const std::runtime_error& e) {
+            log_warning("looking for new HaFX boards: " + std::string{e.what()});
+        }
+        return;
+    }
+
+    // An idle board may have been reconnected somewhere new since;
+    // one stuck in a poll can't be asked, so it's matched on where it
+    // was last seen.
+    for (const auto& [ch, _] : hafx_ctrl) {
+        auto& poller = *hafx_pollers.at(ch);
+        if (!poller.busy()) {
+            poller.drain();
+            note_hafx_location(ch);
+        }
+    }
+    mark_hafx_departed(
+        hafx_locations, hafx_pollers,
+        LibUsbCpp::UsbLocation{.bus = cmd.bus, .address = cmd.address});
+}
+
+std::vector<dm::HafxChannel> mark_hafx_departed(
+    std::unordered_map<dm::HafxChannel, LibUsbCpp::UsbLocation> const& last_seen,
+    std::unordered_map<dm::HafxChannel, std::unique_ptr<DevicePoller> >& pollers,
+    LibUsbCpp::UsbLocation gone)
+{
+    std::vector<dm::HafxChannel> matched;
+    for (auto const& [ch, loc] : last_seen) {
+        auto poller = pollers.find(ch);
+        if (loc != gone || poller == pollers.end()) {
+            continue;
+        }
+        poller->second->device_left();
+        matched.push_back(ch);
+    }
+    return matched;
 }
 
 void DetectorService::initialize() {
@@ -152,13 +412,15 @@ void DetectorService::initialize() {
 }
 
 void DetectorService::handle_command(dm::Shutdown) {
-    nominal_timer = nullptr;
-    health_timer = nullptr;
-    hafx_debug_hist_timer = nullptr;
-    hafx_debug_list_timer = nullptr;
-    x123_debug_hist_timer = nullptr;
-    hafx_nrl_list_timer = nullptr;
-
+    nominal_timer.reset();
+    health_timer.reset();
+    hafx_debug_hist_timer.reset();
+    hafx_debug_list_timer.reset();
+    x123_debug_hist_timer.reset();
+    hafx_nrl_list_timer.reset();
+    hafx_slice_drain_timer.reset();
+
+    drain_pollers();
     x123_ctrl = nullptr;
     hafx_ctrl.clear();
 
@@ -191,14 +453,16 @@ void DetectorService::handle_command(dm::StartPeriodicHealth cmd) {
         send_health(dest, hp);
     }
 
-    using namespace std::chrono_literals;
-    health_timer = TimerLifetime::create(
-        queue.push_delay(cmd, cmd.seconds_between * 1s)
-    );
+    if (!cmd.started) {
+        cmd.started = true;
+        health_timer = schedule_periodic(cmd, cmd.seconds_between * 1s);
+        return;
+    }
+    report_overruns(health_timer, "health");
 }
 
 void DetectorService::handle_command(dm::StopPeriodicHealth) {
-    health_timer = nullptr;
+    health_timer.reset();
 }
 
 std::vector<std::byte> DetectorService::generate_health() {
@@ -207,17 +471,21 @@ std::vector<std::byte> DetectorService::generate_health() {
 
     health_pack.timestamp = time(NULL);
 
-    // only add health from connected detectors
-    if (hafx_ctrl.contains(dm::HafxChannel::C1))
+    // only add health from connected detectors;
+    // one still stuck in a poll is left out rather than waited on
+    auto available = [this](dm::HafxChannel ch) {
+        return hafx_ctrl.contains(ch) && !hafx_pollers.at(ch)->busy();
+    };
+    if (available(dm::HafxChannel::C1))
         health_pack.c1 = hafx_ctrl[dm::HafxChannel::C1]->generate_health();
-    if (hafx_ctrl.contains(dm::HafxChannel::M1))
+    if (available(dm::HafxChannel::M1))
         health_pack.m1 = hafx_ctrl[dm::HafxChannel::M1]->generate_health();
-    if (hafx_ctrl.contains(dm::HafxChannel::M5))
+    if (available(dm::HafxChannel::M5))
         health_pack.m5 = hafx_ctrl[dm::HafxChannel::M5]->generate_health();
-    if (hafx_ctrl.contains(dm::HafxChannel::X1))
+    if (available(dm::HafxChannel::X1))
         health_pack.x1 = hafx_ctrl[dm::HafxChannel::X1]->generate_health();
 
-    if (x123_ctrl->driver_valid()) {
+    if (!x123_poller->busy() && x123_ctrl->driver_valid()) {
         health_pack.x123 = x123_ctrl->generate_health();
     }
 
@@ -230,18 +498,19 @@ std::vector<std::byte> DetectorService::generate_health() {
     return ret;
 }
 
-void DetectorService::handle_command(dm::HafxSettings cmd) {
-    auto channel = cmd.ch;
+void DetectorService::handle_command(dm::Boxed<dm::HafxSettings> cmd) {
+    auto channel = cmd->ch;
     try {
-        hafx_ctrl.at(channel)->update_settings(cmd);
+        idle_hafx(channel).update_settings(*cmd);
     } catch (const std::out_of_range&) {
         throw DetectorException{"Channel not valid for settings modification (detector not connected)"};
     }
 }
 
-void DetectorService::handle_command(dm::X123Settings cmd) {
+void DetectorService::handle_command(dm::Boxed<dm::X123Settings> cmd) {
     try {
-        x123_ctrl->update_settings(cmd);
+        x123_poller->drain();
+        x123_ctrl->update_settings(*cmd);
     } catch (const std::runtime_error& e) {
         throw DetectorException{"X123 issue: " + std::string{e.what()}};
     }
@@ -254,14 +523,14 @@ void DetectorService::handle_command(dm::HafxDebug cmd) {
 
     using dbr_t = dm::HafxDebug;
     const auto acq_type = cmd.type;
-    auto& ctrl = hafx_ctrl.at(cmd.ch);
+    auto& ctrl = idle_hafx(cmd.ch);
 
     auto delay = std::chrono::seconds(cmd.wait_between);
 
     // Make a macro to keep this more easily updated
     #define BASIC_READ(tname) \
         if (acq_type == dbr_t::Type::tname) \
-            { ctrl->read_save_debug<SipmUsb::tname>(); }
+            { ctrl.read_save_debug<SipmUsb::tname>(); }
     BASIC_READ(ArmCtrl)
     else BASIC_READ(ArmCal)
     else BASIC_READ(ArmStatus)
@@ -273,22 +542,22 @@ void DetectorService::handle_command(dm::HafxDebug cmd) {
 
     // reads after a delay
     else if (acq_type == dbr_t::Type::FpgaOscilloscopeTrace) {
-        ctrl->restart_trace();
-        hafx_debug_trace_timer = TimerLifetime::create(
+        ctrl.restart_trace();
+        hafx_debug_trace_timer = TimerLifetime{
             queue.push_delay(dm::QueryTraceAcquisition{cmd.ch}, delay)
-        );
+        };
     }
     else if (acq_type == dbr_t::Type::Histogram) {
-        ctrl->restart_time_slice_or_histogram();
-        hafx_debug_hist_timer = TimerLifetime::create(
+        ctrl.restart_time_slice_or_histogram();
+        hafx_debug_hist_timer = TimerLifetime{
             queue.push_delay(dm::QueryLegacyHistogram{cmd.ch}, delay)
-        );
+        };
     }
     else if (acq_type == dbr_t::Type::ListMode) {
-        ctrl->restart_list_mode();
-        hafx_debug_list_timer = TimerLifetime::create(
+        ctrl.restart_list_mode();
+        hafx_debug_list_timer = TimerLifetime{
             queue.push_delay(dm::QueryListMode{cmd.ch}, delay)
-        );
+        };
     }
 }
 
@@ -297,6 +566,7 @@ void DetectorService::handle_command(dm::X123Debug cmd) {
         throw DetectorException{"Cannot take debug data during nominal data collection"};
     }
 
+    x123_poller->drain();
     if (!x123_ctrl || !x123_ctrl->driver_valid()) {
         throw DetectorException{"X123 not connected"};
     }
@@ -318,9 +588,9 @@ void DetectorService::x123_debug(dm::X123Debug cmd) {
     else if (what == dbg_t::Type::Histogram) {
         x123_ctrl->init_debug_histogram();
         auto delay = std::chrono::seconds(cmd.histogram_wait);
-        x123_debug_hist_timer = TimerLifetime::create(
+        x123_debug_hist_timer = TimerLifetime{
             queue.push_delay(dm::QueryX123DebugHistogram{}, delay)
-        );
+        };
     }
 
     else if (what == dbg_t::Type::AsciiSettings) {
@@ -337,10 +607,11 @@ void DetectorService::handle_command(dm::QueryTraceAcquisition cmd) {
     auto TIME_LIMIT = 5s;
     auto then = std::chrono::system_clock::now();
     while ((std::chrono::system_clock::now() - then) < TIME_LIMIT) {
-        auto trace_done = hafx_ctrl.at(cmd.ch)->check_trace_done();
+        auto& ctrl = idle_hafx(cmd.ch);
+        auto trace_done = ctrl.check_trace_done();
         if (trace_done) {
             using trace_t = SipmUsb::FpgaOscilloscopeTrace;
-            hafx_ctrl.at(cmd.ch)->read_save_debug<trace_t>();
+            ctrl.read_save_debug<trace_t>();
             return;
         }
         std::this_thread::sleep_for(100ms);
@@ -351,15 +622,16 @@ void DetectorService::handle_command(dm::QueryTraceAcquisition cmd) {
 
 void DetectorService::handle_command(dm::QueryListMode cmd) {
     using list_t = SipmUsb::FpgaListMode;
-    hafx_ctrl.at(cmd.ch)->read_save_debug<list_t>();
+    idle_hafx(cmd.ch).read_save_debug<list_t>();
 }
 
 void DetectorService::handle_command(dm::QueryLegacyHistogram cmd) {
     using hg_t = SipmUsb::FpgaHistogram;
-    hafx_ctrl.at(cmd.ch)->read_save_debug<hg_t>();
+    idle_hafx(cmd.ch).read_save_debug<hg_t>();
 }
 
 void DetectorService::handle_command(dm::QueryX123DebugHistogram) {
+    x123_poller->drain();
     x123_ctrl->read_save_debug_histogram();
 }
 
@@ -367,44 +639,139 @@ bool DetectorService::await_pps_edge() const {
     return (0 == std::system("detect-edge 31"));
 }
 
-void DetectorService::read_all_time_slices() {
+void DetectorService::start_hafx(
+    std::function<void(Detector::HafxControl&)> job,
+    std::chrono::steady_clock::time_point now
+) {
     for (const auto& [ch, ctrl] : hafx_ctrl) {
-        try {
-            ctrl->poll_save_time_slice();
+        auto* c = ctrl.get();
+        auto& poller = *hafx_pollers.at(ch);
+        if (poller.health().state() == DeviceHealth::State::quarantined) {
+            // the board may have dropped off the bus and come back,
+            // so its retry starts with a fresh connection
+            auto depth = hafx_usb_pipeline_depth;
+            poller.start([c, job, depth]() {
+                c->reconnect(depth);
+                job(*c);
+            }, now);
+            continue;
+        }
+        poller.start([c, job]() { job(*c); }, now);
+    }
+}
+
+void DetectorService::finish_hafx(std::chrono::steady_clock::time_point deadline) {
+    for (const auto& [ch, _] : hafx_ctrl) {
+        hafx_pollers.at(ch)->finish(deadline);
+    }
+}
+
+void DetectorService::drain_pollers() {
+    for (auto& [_, poller] : hafx_pollers) {
+        poller->drain();
+    }
+    x123_poller->drain();
+}
+
+Detector::HafxControl& DetectorService::idle_hafx(dm::HafxChannel ch) {
+    // throws std::out_of_range if the channel isn't connected
+    auto& ctrl = *hafx_ctrl.at(ch);
+    hafx_pollers.at(ch)->drain();
+    return ctrl;
+}
+
+void DetectorService::note_hafx_location(dm::HafxChannel ch) {
+    if (auto loc = hafx_ctrl.at(ch)->usb_location()) {
+        hafx_locations[ch] = *loc;
+    }
+}
+
+void DetectorService::read_all_time_slices() {
+    auto now = std::chrono::steady_clock::now();
+    start_hafx([](Detector::HafxControl& ctrl) {
+        ctrl.poll_save_time_slice();
+    }, now);
+    finish_hafx(now + poll_budget);
+    schedule_slice_drain();
+}
+
+void DetectorService::schedule_slice_drain() {
+    uint16_t waiting = 0;
+    bool overflowed = false;
+    for (auto& [ch, ctrl] : hafx_ctrl) {
+        // a poll still running in the background isn't ours to look at
+        if (hafx_pollers.at(ch)->busy()) {
+            continue;
         }
-        catch (std::runtime_error const& e) {
-            throw ReconnectDetectors{"hafx issue: " + std::string{e.what()}};
+        if (auto poll = ctrl->take_time_slice_poll()) {
+            waiting = std::max(waiting, poll->waiting);
+            overflowed = overflowed || poll->overflowed;
         }
     }
+    slice_drain.record(waiting, overflowed);
+
+    // replaces any drain that was still to come
+    hafx_slice_drain_timer = TimerLifetime{queue.push_delay(
+        dm::ImmediateHafxTimeSliceRead{},
+        slice_drain.interval()
+    )};
 }
 
-void DetectorService::handle_command(dm::CollectNominal cmd) {
-    auto finish = [this](auto cmd) {
-        constexpr auto TIME_SLICE_DELAY = 2s;
-        nominal_timer = TimerLifetime::create(queue.push_delay(cmd, TIME_SLICE_DELAY));
-    };
+void DetectorService::handle_command(dm::ImmediateHafxTimeSliceRead) {
+    // a leftover from before nominal stopped
+    if (!nominal_timer) {
+        return;
+    }
+    log_debug("nominal tick is late; draining HaFX time slices early");
+    read_all_time_slices();
+}
 
+void DetectorService::handle_command(dm::CollectNominal cmd) {
     if (!cmd.started) {
-        start_nominal();
-        cmd.started = true;
-        finish(cmd);
+        constexpr auto TIME_SLICE_DELAY = 2s;
+        slice_drain = SliceDrainScheduler{};
+        auto pps = start_nominal();
+        nominal_timer = schedule_periodic(
+            dm::CollectNominal{.started = true},
+            TIME_SLICE_DELAY,
+            pps
+        );
         return;
     }
-    try {
+
+    report_overruns(nominal_timer, "nominal");
+
+    // the X-123 and HaFX boards are all read at the same time,
+    // and share one time budget
+    auto now = std::chrono::steady_clock::now();
+    auto x123_retry = (x123_poller->health().state() == DeviceHealth::State::quarantined);
+    x123_poller->start([this, x123_retry]() {
+        if (x123_retry) {
+            x123_ctrl->reconnect();
+        }
         x123_ctrl->read_save_sequential_buffer();
-    } catch (const DetectorException& e) {
-        log_debug("x123 disconnected: " + std::string{e.what()});
-    }
+    }, now);
+    start_hafx([](Detector::HafxControl& ctrl) {
+        ctrl.poll_save_time_slice();
+    }, now);
 
-    read_all_time_slices();
-    finish(cmd);
+    auto deadline = now + poll_budget;
+    x123_poller->finish(deadline);
+    finish_hafx(deadline);
+    schedule_slice_drain();
 }
 
-void DetectorService::start_nominal() {
+std::optional<std::chrono::steady_clock::time_point> DetectorService::start_nominal() {
     // wait until the PPS comes in to start these operations
     // for a good initial time sync
     // assumption: all of the rest of the init process can take place in < 1s
-    if (!await_pps_edge()) {
+    drain_pollers();
+
+    std::optional<std::chrono::steady_clock::time_point> pps;
+    if (await_pps_edge()) {
+        pps = std::chrono::steady_clock::now();
+    }
+    else {
         log_warning("Cannot obtain PPS detect for IMPRESS mode");
     }
 
@@ -441,32 +808,68 @@ void DetectorService::start_nominal() {
     for (auto& [ch, ctrl] : hafx_ctrl) {
         ctrl->data_time_anchor(restore_anchor);
     }
+
+    return pps;
 }
 
 void DetectorService::handle_command(dm::StopNominal) {
     try {
+        x123_poller->drain();
         x123_ctrl->stop_sequential_buffering();
     } catch (const DetectorException& e) {
         log_warning("X123 issue: " + std::string{e.what()});
     }
-    nominal_timer = nullptr;
+    nominal_timer.reset();
+    hafx_slice_drain_timer.reset();
+
+    // the per-drain warnings name the boards; this is the tally
+    if (auto lost = slice_drain.overflow_count()) {
+        log_warning(
+            "nominal: HaFX time slices were lost in " +
+            std::to_string(lost) + " drain(s)"
+        );
+    }
 }
 
-void DetectorService::check_save_nrl_buffers() {
-    for (const auto& [_, ctrl] : hafx_ctrl) {
-        try {
-            ctrl->poll_save_nrl_list();
-        }
-        catch (std::runtime_error const& e) {
-            throw ReconnectDetectors{"hafx issue: " + std::string{e.what()}};
+std::chrono::milliseconds DetectorService::check_save_nrl_buffers(
+    std::chrono::steady_clock::time_point now
+) {
+    start_hafx([](Detector::HafxControl& ctrl) {
+        ctrl.poll_save_nrl_list();
+    }, now);
+    finish_hafx(now + poll_budget);
+
+    // the busiest board sets the pace for all of them
+    auto period = nrl_poll_config.max_period;
+    for (auto& [ch, ctrl] : hafx_ctrl) {
+        auto it = nrl_poll_rates.try_emplace(ch, nrl_poll_config, now).first;
+        // a poll still running in the background isn't ours to look at
+        auto poll = hafx_pollers.at(ch)->busy()
+            ? std::nullopt
+            : ctrl->take_nrl_poll();
+        if (poll) {
+            it->second.record(now, *poll);
+            if (poll->both_full) {
+                log_warning(
+                    hafx_name(ch) + ": both NRL banks were full, events may be lost (" +
+                    std::to_string(it->second.both_full_count()) + " times so far)");
+            }
         }
+        period = std::min(period, it->second.period());
     }
+    return period;
 }
 
-void DetectorService::start_nrl_list_mode() {
+std::optional<std::chrono::steady_clock::time_point> DetectorService::start_nrl_list_mode() {
     // wait for pps before starting in order to synchronize the
     // data on our end with the PPS, akin to IMPRESS
-    if (!await_pps_edge()) {
+    drain_pollers();
+
+    std::optional<std::chrono::steady_clock::time_point> pps;
+    if (await_pps_edge()) {
+        pps = std::chrono::steady_clock::now();
+    }
+    else {
         log_warning("Can't get PPS detect for NRL list mode");
     }
 
@@ -474,33 +877,75 @@ void DetectorService::start_nrl_list_mode() {
     // too close to the second tick edge;
     // we've seen issues with seconds getting skipped/repeated.
     // make it a prime number to try to prevent getting in phase with the second ticks
-    std::this_thread::sleep_for(317ms);
+    std::this_thread::sleep_for(PPS_OFFSET);
     for (auto& [_, ctrl] : hafx_ctrl) {
         ctrl->restart_list_mode();
     }
+
+    return pps;
 }
 
-void DetectorService::handle_command(dm::StartNrlList cmd) {
-    auto finish = [this](auto cmd) {
-        constexpr auto CHECK_BUFFER_FULL_DELAY = 23ms;
-        hafx_nrl_list_timer = TimerLifetime::create(
-            queue.push_delay(cmd, CHECK_BUFFER_FULL_DELAY)
-        );
-    };
+void DetectorService::arm_nrl_poll() {
+    hafx_nrl_list_timer = TimerLifetime{queue.push_delay(
+        dm::StartNrlList{.started = true},
+        nrl_poll_due - std::chrono::steady_clock::now()
+    )};
+}
 
+void DetectorService::handle_command(dm::StartNrlList cmd) {
     if (!cmd.started) {
-        start_nrl_list_mode();
-        cmd.started = true;
-        finish(cmd);
+        auto pps = start_nrl_list_mode();
+        // list mode restarted with both banks empty
+        auto started = std::chrono::steady_clock::now();
+        nrl_poll_rates.clear();
+        for (auto const& [ch, _] : hafx_ctrl) {
+            nrl_poll_rates.try_emplace(ch, nrl_poll_config, started);
+        }
+        // the same PPS-phased grid as schedule_periodic
+        auto phase = pps ? *pps + PPS_OFFSET : started;
+        nrl_poll_due = next_nrl_poll(phase, nrl_poll_config.initial_period, started).at;
+        arm_nrl_poll();
         return;
     }
 
-    check_save_nrl_buffers();
-    finish(cmd);
+    // One shot at a time, as the period follows the count rate, but
+    // each due a period after the last was due (not after it ran),
+    // so the polls keep their phase and don't drift.
+    auto now = std::chrono::steady_clock::now();
+    auto period = check_save_nrl_buffers(now);
+    auto next = next_nrl_poll(nrl_poll_due, period, std::chrono::steady_clock::now());
+    report_overruns(next.skipped, "NRL");
+    nrl_poll_due = next.at;
+    arm_nrl_poll();
 }
 
 void DetectorService::handle_command(dm::StopNrlList) {
-    hafx_nrl_list_timer = nullptr;
+    hafx_nrl_list_timer.reset();
+
+    // how each board's banks kept up, for looking back on
+    for (auto& [ch, _] : hafx_ctrl) {
+        auto& ctrl = idle_hafx(ch);
+        auto stats = ctrl.nrl_bank_stats();
+        for (size_t bank = 0; bank < stats.size(); ++bank) {
+            auto const& b = stats[bank];
+            log_info(
+                hafx_name(ch) + " NRL bank " +
+                std::to_string(bank) + ": " + std::to_string(b.reads) + " reads, " +
+                std::to_string(b.events) + " events, " +
+                std::to_string(b.overruns) + " overruns, " +
+                std::to_string(b.out_of_turn) + " out of turn, " +
+                std::to_string(b.max_read_latency.count()) + " us longest read");
+        }
+
+        auto flags = ctrl.nrl_flag_counts();
+        log_info(
+            hafx_name(ch) + " NRL flags: " +
+            std::to_string(flags.pps) + " PPS, " +
+            std::to_string(flags.external_trigger) + " external trigger, " +
+            std::to_string(flags.piled_up) + " piled up, " +
+            std::to_string(flags.sum_overflow) + " sum overflow, " +
+            std::to_string(flags.out_of_range) + " out of range");
+    }
 }
 
 void DetectorService::push_message(DetectorService::Message m) {
@@ -508,11 +953,11 @@ void DetectorService::push_message(DetectorService::Message m) {
 
 }
 bool DetectorService::taking_nominal_data() {
-    return (nominal_timer != nullptr);
+    return static_cast<bool>(nominal_timer);
 }
 
 bool DetectorService::taking_nrl_data() {
-    return (hafx_nrl_list_timer != nullptr);
+    return static_cast<bool>(hafx_nrl_list_timer);
 }
 
 bool DetectorService::alive() const {
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
 #include <optional>
 #include <variant>
 #include <vector>
 
 #include <logging.hh>
 #include <thread_safe_queue.hh>
+#include <DevicePoller.hh>
+#include <NrlPollScheduler.hh>
+#include <SliceDrainScheduler.hh>
 
 #include <DetectorMessages.hh>
 
@@ -20,8 +25,9 @@ public:
         DetectorMessages::Initialize,
         DetectorMessages::Shutdown, 
 
-        DetectorMessages::HafxSettings,
-        DetectorMessages::X123Settings,
+        // settings are large, so only a pointer to them is queued
+        DetectorMessages::Boxed<DetectorMessages::HafxSettings>,
+        DetectorMessages::Boxed<DetectorMessages::X123Settings>,
 
         DetectorMessages::HafxDebug,
         DetectorMessages::X123Debug,
@@ -34,11 +40,30 @@ public:
         DetectorMessages::StopPeriodicHealth,
         DetectorMessages::CollectNominal,
         DetectorMessages::StopNominal,
+        DetectorMessages::ImmediateHafxTimeSliceRead,
         DetectorMessages::StartNrlList,
         DetectorMessages::StopNrlList,
+        DetectorMessages::UsbHotplug,
         DetectorMessages::PromiseWrap
     >;
 
+    // Queue classes, popped in this order.  Polling ticks must not sit
+    // behind a slow debug read or settings upload, or the Bridgeport
+    // list buffers overflow.  ThreadSafeQueue keeps the lower classes
+    // from starving.
+    enum class Priority : size_t {
+        // nominal and NRL polling ticks
+        Science,
+        // ground commands: start/stop, settings, init
+        Command,
+        // health ticks and debug reads
+        Housekeeping,
+    };
+    struct MessagePriority {
+        static constexpr size_t CLASSES = 3;
+        size_t operator()(Message const& m) const;
+    };
+
     void push_message(Message c);
     bool taking_nominal_data();
     bool taking_nrl_data();
@@ -57,6 +82,20 @@ public:
     void put_x123_ports(Detector::DetectorPorts);
     void put_hafx_serial_nums(
         std::unordered_map<DetectorMessages::HafxChannel, std::string>);
+    // USB chunks in flight per HaFX board; 0 for synchronous transfers
+    void put_hafx_usb_pipeline_depth(size_t depth);
+    // What the HaFX boards send time slices as, from the next connect
+    void put_hafx_time_slice_format(Detector::TimeSliceFormat format);
+    // How long one poll of the detectors may take before a device
+    // that hasn't answered is skipped (see DevicePoller)
+    void put_poll_budget(std::chrono::milliseconds budget);
+    // Shortest and longest the NRL poll period may get; in between it
+    // follows the count rate (see NrlPollScheduler)
+    void put_nrl_poll_bounds(std::chrono::milliseconds min, std::chrono::milliseconds max);
+    // Turn the source's USB arrivals and departures into UsbHotplug
+    // messages, so detectors are dropped and picked back up without
+    // waiting on USB timeouts
+    void watch_hotplug(std::unique_ptr<LibUsbCpp::HotplugSource> source);
 
     // Wait for an incoming PPS edge
     bool await_pps_edge() const;
@@ -73,7 +112,9 @@ private:
     std::unordered_map<
         DetectorMessages::HafxChannel, Detector::DetectorPorts> hafx_ports;
 
-    ThreadSafeQueue<Message> queue; 
+    ThreadSafeQueue<Message, MessagePriority> queue;
+    // after the queue: it pushes onto it until destroyed
+    std::unique_ptr<LibUsbCpp::HotplugSource> hotplug;
     std::unique_ptr<Detector::X123Control> x123_ctrl;
 
     std::unordered_map<
@@ -82,21 +123,44 @@ private:
     std::unordered_map<
         DetectorMessages::HafxChannel,
         std::string> hafx_serial_nums;
+    // Where each board was last seen on the bus, so a departure can be
+    // matched to one that's stuck in a poll (and can't be asked)
+    std::unordered_map<
+        DetectorMessages::HafxChannel,
+        LibUsbCpp::UsbLocation> hafx_locations;
+    size_t hafx_usb_pipeline_depth;
+    Detector::TimeSliceFormat hafx_slice_format;
+
+    // one thread and circuit breaker per detector so they can all be
+    // polled at once, and a stalled one doesn't hold up the rest
+    std::unordered_map<
+        DetectorMessages::HafxChannel,
+        std::unique_ptr<DevicePoller> > hafx_pollers;
+    std::unique_ptr<DevicePoller> x123_poller;
+    std::chrono::milliseconds poll_budget;
+    NrlPollConfig nrl_poll_config;
+    std::unordered_map<
+        DetectorMessages::HafxChannel, NrlPollScheduler> nrl_poll_rates;
+    // when the NRL poll hafx_nrl_list_timer is armed for was due
+    std::chrono::steady_clock::time_point nrl_poll_due;
+    SliceDrainScheduler slice_drain;
 
     // timers
-    std::unique_ptr<TimerLifetime> nominal_timer;
-    std::unique_ptr<TimerLifetime> health_timer;
-    std::unique_ptr<TimerLifetime> hafx_debug_trace_timer;
-    std::unique_ptr<TimerLifetime> hafx_debug_hist_timer;
-    std::unique_ptr<TimerLifetime> hafx_debug_list_timer;
-    std::unique_ptr<TimerLifetime> x123_debug_hist_timer;
-    std::unique_ptr<TimerLifetime> hafx_nrl_list_timer;
+    TimerLifetime nominal_timer;
+    TimerLifetime health_timer;
+    TimerLifetime hafx_debug_trace_timer;
+    TimerLifetime hafx_debug_hist_timer;
+    TimerLifetime hafx_debug_list_timer;
+    TimerLifetime x123_debug_hist_timer;
+    TimerLifetime hafx_nrl_list_timer;
+    // drains the time slice FIFOs between nominal ticks, if one is slow
+    TimerLifetime hafx_slice_drain_timer;
 
     // command handlers
     void handle_command(DetectorMessages::Initialize cmd);
     void handle_command(DetectorMessages::Shutdown cmd);
-    void handle_command(DetectorMessages::HafxSettings cmd);
-    void handle_command(DetectorMessages::X123Settings cmd);
+    void handle_command(DetectorMessages::Boxed<DetectorMessages::HafxSettings> cmd);
+    void handle_command(DetectorMessages::Boxed<DetectorMessages::X123Settings> cmd);
     void handle_command(DetectorMessages::HafxDebug cmd);
     void handle_command(DetectorMessages::X123Debug cmd);
     void handle_command(DetectorMessages::QueryTraceAcquisition cmd);
@@ -107,8 +171,10 @@ private:
     void handle_command(DetectorMessages::StartPeriodicHealth cmd);
     void handle_command(DetectorMessages::StopPeriodicHealth cmd);
     void handle_command(DetectorMessages::CollectNominal cmd);
+    void handle_command(DetectorMessages::ImmediateHafxTimeSliceRead cmd);
     void handle_command(DetectorMessages::StartNrlList cmd);
     void handle_command(DetectorMessages::StopNrlList cmd);
+    void handle_command(DetectorMessages::UsbHotplug cmd);
     void handle_command(DetectorMessages::PromiseWrap msg);
 
     // implementations & helpers for `handle_command`s
@@ -119,10 +185,70 @@ private:
 
     // helpers
     void initialize();
-    void start_nominal();
+    // These return when the PPS edge they waited for came in (if it did)
+    std::optional<std::chrono::steady_clock::time_point> start_nominal();
     void read_all_time_slices();
-    void start_nrl_list_mode();
-    void check_save_nrl_buffers();
+    // After the HaFX time slices are read: see what they found and
+    // when the next early drain is due (see SliceDrainScheduler)
+    void schedule_slice_drain();
+    std::optional<std::chrono::steady_clock::time_point> start_nrl_list_mode();
+    // Returns how long to wait before the next one
+    std::chrono::milliseconds check_save_nrl_buffers(std::chrono::steady_clock::time_point now);
     void reconnect_detectors();
+    // Reconnect just the X-123; the HaFX boards keep their
+    // connections, time anchors and queued data
+    void reconnect_x123();
+    // Pick up configured boards that weren't there before
+    void attach_missing_hafx();
+    // Control for the board on `chan`, set up as configured
+    std::unique_ptr<Detector::HafxControl> make_hafx(
+        DetectorMessages::HafxChannel chan, std::shared_ptr<SipmUsb::UsbManager> device);
     void x123_debug(DetectorMessages::X123Debug);
+
+    // Start `job` on every connected HaFX board's worker at once.
+    // Quarantined boards are skipped until their retry is due, and
+    // then reconnected first.
+    void start_hafx(
+        std::function<void(Detector::HafxControl&)> job,
+        std::chrono::steady_clock::time_point now);
+    // Wait for them until `deadline`.  Failures and overruns go to
+    // each board's circuit breaker; they are logged, not thrown.
+    void finish_hafx(std::chrono::steady_clock::time_point deadline);
+    // Wait out any poll still running in the background, so the
+    // detector objects can be used from this thread or destroyed
+    void drain_pollers();
+    Detector::HafxControl& idle_hafx(DetectorMessages::HafxChannel ch);
+    // Update hafx_locations for a board whose poller is idle
+    void note_hafx_location(DetectorMessages::HafxChannel ch);
+
+    // Queue a copy of `cmd` every `period` on absolute deadlines, so
+    // the schedule doesn't slip by however long each tick takes.
+    // Given a PPS edge, ticks are phase-locked to it.
+    template<typename Cmd>
+    TimerLifetime schedule_periodic(
+        Cmd cmd,
+        std::chrono::milliseconds period,
+        std::optional<std::chrono::steady_clock::time_point> pps = {}
+    );
+    // Log any ticks a periodic timer had to skip
+    void report_overruns(TimerLifetime& timer, const std::string& what);
+    void report_overruns(uint64_t missed, const std::string& what);
+    // Arm hafx_nrl_list_timer for nrl_poll_due
+    void arm_nrl_poll();
 };
+
+// Tell the poller of each board last seen at `gone` that it left.
+// Fine for a board stuck in a poll: only its circuit breaker changes,
+// which a running poll never touches, so the stuck job is left to fail
+// in the background and nothing new starts on the board until it's
+// back.  Returns the channels it matched.
+std::vector<DetectorMessages::HafxChannel> mark_hafx_departed(
+    std::unordered_map<
+        DetectorMessages::HafxChannel, LibUsbCpp::UsbLocation> const& last_seen,
+    std::unordered_map<
+        DetectorMessages::HafxChannel, std::unique_ptr<DevicePoller> >& pollers,
+    LibUsbCpp::UsbLocation gone);
+
+// Every tick of the nominal and NRL loops is moved through the queue,
+// so keep the message small (see DetectorMessages::Boxed).
+static_assert(sizeof(DetectorService::Message) <= 128);
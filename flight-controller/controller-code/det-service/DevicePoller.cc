@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <exception>
+
+#include <logging.hh>
+
+#include "DevicePoller.hh"
+
+DeviceHealth::DeviceHealth(Config config) :
+    config{config},
+    current{State::healthy},
+    failures{0},
+    backoff{config.retry_after},
+    retry_at{}
+{ }
+
+DeviceHealth::State DeviceHealth::state() const {
+    return current;
+}
+
+unsigned DeviceHealth::consecutive_failures() const {
+    return failures;
+}
+
+bool DeviceHealth::should_poll(clock::time_point now) const {
+    return current != State::quarantined || now >= retry_at;
+}
+
+void DeviceHealth::record_success() {
+    current = State::healthy;
+    failures = 0;
+    backoff = config.retry_after;
+}
+
+void DeviceHealth::record_failure(clock::time_point now) {
+    ++failures;
+    if (current == State::quarantined) {
+        // the retry failed as well
+        backoff = std::min(2 * backoff, config.max_retry_after);
+        retry_at = now + backoff;
+    }
+    else if (failures >= config.failures_to_quarantine) {
+        current = State::quarantined;
+        backoff = config.retry_after;
+        retry_at = now + backoff;
+    }
+    else {
+        current = State::degraded;
+    }
+}
+
+void DeviceHealth::record_departure() {
+    current = State::quarantined;
+    backoff = config.retry_after;
+    retry_at = clock::time_point::max();
+}
+
+void DeviceHealth::record_arrival() {
+    if (current == State::quarantined) {
+        backoff = config.retry_after;
+        retry_at = clock::time_point::min();
+    }
+}
+
+std::string to_string(DeviceHealth::State s) {
+    switch (s) {
+        case DeviceHealth::State::healthy: return "healthy";
+        case DeviceHealth::State::degraded: return "degraded";
+        case DeviceHealth::State::quarantined: return "quarantined";
+    }
+    return "unknown";
+}
+
+
+DevicePoller::DevicePoller(std::string name, DeviceHealth::Config config) :
+    name{std::move(name)},
+    breaker{config},
+    running{},
+    overran{false},
+    worker{}
+{ }
+
+bool DevicePoller::start(std::function<void()> job, clock::time_point now) {
+    if (running) {
+        if (running->wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+            // still stuck in the job that overran
+            return false;
+        }
+        collect();
+    }
+    if (!breaker.should_poll(now)) {
+        return false;
+    }
+
+    running = worker.submit(std::move(job));
+    overran = false;
+    return true;
+}
+
+DevicePoller::Outcome DevicePoller::finish(clock::time_point deadline) {
+    if (!running || overran) {
+        return Outcome::skipped;
+    }
+
+    if (running->wait_until(deadline) != std::future_status::ready) {
+        auto before = breaker.state();
+        overran = true;
+        breaker.record_failure(clock::now());
+        log_transition(before, "poll overran its time budget");
+        return Outcome::timed_out;
+    }
+    return collect();
+}
+
+bool DevicePoller::busy() const {
+    return running && running->wait_for(std::chrono::seconds{0}) != std::future_status::ready;
+}
+
+void DevicePoller::drain() {
+    if (running) {
+        running->wait();
+        collect();
+    }
+}
+
+void DevicePoller::device_left() {
+    breaker.record_departure();
+    log_warning(name + " unplugged; not polling it until it's back");
+}
+
+void DevicePoller::device_arrived() {
+    if (breaker.state() == DeviceHealth::State::quarantined) {
+        log_info(name + " plugged back in; retrying it");
+    }
+    breaker.record_arrival();
+}
+
+const DeviceHealth& DevicePoller::health() const {
+    return breaker;
+}
+
+DevicePoller::Outcome DevicePoller::collect() {
+    auto before = breaker.state();
+    auto counted = overran;
+    auto fut = std::move(*running);
+    running.reset();
+    overran = false;
+
+    try {
+        fut.get();
+    }
+    catch (const std::exception& e) {
+        // a job that overran was already counted when it did
+        if (!counted) {
+            breaker.record_failure(clock::now());
+        }
+        log_transition(before, e.what());
+        return Outcome::failed;
+    }
+
+    // A job that overran stays a failure even if it got there in the
+    // end, or a board that's always too slow would never be quarantined
+    if (!counted) {
+        breaker.record_success();
+        log_transition(before, "poll succeeded");
+    }
+    return Outcome::ok;
+}
+
+void DevicePoller::log_transition(DeviceHealth::State before, const std::string& why) {
+    using st = DeviceHealth::State;
+    auto after = breaker.state();
+    auto msg = name + " " + to_string(after) + ": " + why;
+
+    if (after == st::quarantined) {
+        auto n = std::to_string(breaker.consecutive_failures());
+        if (before != st::quarantined) {
+            log_error(msg + " (" + n + " failed polls; skipping it and retrying in the background)");
+        }
+        else {
+            log_debug(msg + " (retry failed; " + n + " failed polls)");
+        }
+    }
+    else if (after == st::degraded) {
+        log_warning(msg);
+    }
+    else if (before != st::healthy) {
+        log_info(name + " healthy again");
+    }
+}
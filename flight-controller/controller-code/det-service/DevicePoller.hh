@@ -0,0 +1,127 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <optional>
+#include <string>
+
+#include <DeviceWorker.hh>
+
+struct DeviceHealthConfig {
+    // failed polls in a row before the device is quarantined
+    unsigned failures_to_quarantine = 3;
+    // first retry of a quarantined device ...
+    std::chrono::milliseconds retry_after{5000};
+    // ... and the longest the backoff grows to
+    std::chrono::milliseconds max_retry_after{120000};
+};
+
+/*
+ * Circuit breaker for one detector.
+ *
+ * A device that fails a poll (USB error or over its time budget) is
+ * degraded but still polled.  After enough failures in a row it is
+ * quarantined: left out of the poll cycle, apart from one retry
+ * after a backoff which doubles each time the retry fails too.  Any
+ * poll that succeeds within its budget makes it healthy again.
+ */
+class DeviceHealth {
+public:
+    using clock = std::chrono::steady_clock;
+
+    enum class State {
+        healthy,
+        degraded,
+        quarantined,
+    };
+
+    using Config = DeviceHealthConfig;
+
+    explicit DeviceHealth(Config config = {});
+
+    State state() const;
+    unsigned consecutive_failures() const;
+
+    // False while quarantined, until the next retry is due
+    bool should_poll(clock::time_point now) const;
+
+    void record_success();
+    void record_failure(clock::time_point now);
+
+    // Unplugged: quarantined with no retry until it comes back
+    void record_departure();
+    // Plugged back in: a quarantined device is retried straight away
+    void record_arrival();
+
+private:
+    Config config;
+    State current;
+    unsigned failures;
+    std::chrono::milliseconds backoff;
+    clock::time_point retry_at;
+};
+
+std::string to_string(DeviceHealth::State s);
+
+
+/*
+ * Polls one detector on its own DeviceWorker, within a time budget.
+ *
+ * A job that is still running at the deadline is not waited for: it
+ * counts as a failure and is left to finish (or time out in libusb)
+ * in the background, and the device is skipped until it has.  That
+ * way one stalled board holds up the poll cycle by at most the budget
+ * while the others keep acquiring.
+ *
+ * Jobs get a reference to the detector object, so call drain() before
+ * using it from another thread or destroying it.
+ */
+class DevicePoller {
+public:
+    using clock = std::chrono::steady_clock;
+
+    enum class Outcome {
+        ok,
+        failed,
+        timed_out,
+        // nothing was started this cycle
+        skipped,
+    };
+
+    explicit DevicePoller(std::string name, DeviceHealth::Config config = {});
+
+    // Run `job` on the worker, unless the device is quarantined or
+    // still busy with an earlier job that overran.  Returns whether
+    // the job was started.
+    bool start(std::function<void()> job, clock::time_point now = clock::now());
+
+    // Wait until `deadline` for the job from start() and record how it
+    // went.  Errors are logged, not thrown.
+    Outcome finish(clock::time_point deadline);
+
+    // True while a job that overran its budget is still running
+    bool busy() const;
+
+    // Block until no job is running
+    void drain();
+
+    // Hotplug notices; see DeviceHealth
+    void device_left();
+    void device_arrived();
+
+    const DeviceHealth& health() const;
+
+private:
+    std::string name;
+    DeviceHealth breaker;
+    std::optional<std::future<void>> running;
+    // the running job was already counted as a failure
+    bool overran;
+    // declared last so its thread is joined before anything else goes
+    DeviceWorker worker;
+
+    // Take the result of a finished job
+    Outcome collect();
+    void log_transition(DeviceHealth::State before, const std::string& why);
+};
@@ -0,0 +1,47 @@
+#include "DeviceWorker.hh"
+
+DeviceWorker::DeviceWorker() :
+    mtx{},
+    cv{},
+    jobs{},
+    stopping{false},
+    thread{&DeviceWorker::run, this}
+{ }
+
+DeviceWorker::~DeviceWorker() {
+    {
+        std::lock_guard lock{mtx};
+        stopping = true;
+    }
+    cv.notify_one();
+    thread.join();
+}
+
+std::future<void> DeviceWorker::submit(std::function<void()> job) {
+    std::packaged_task<void()> task{std::move(job)};
+    auto fut = task.get_future();
+    {
+        std::lock_guard lock{mtx};
+        jobs.push_back(std::move(task));
+    }
+    cv.notify_one();
+    return fut;
+}
+
+void DeviceWorker::run() {
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock lock{mtx};
+            cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                // stopping, and nothing left to do
+                return;
+            }
+            task = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        // exceptions are stored in the task's future
+        task();
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+/*
+ * A thread that runs the blocking USB work for one detector.
+ *
+ * DetectorService hands each detector's poll to its own worker and
+ * then waits on all of them, so a poll takes as long as the slowest
+ * detector instead of the sum of all of them.  See DevicePoller for
+ * how jobs that overrun are handled.
+ */
+class DeviceWorker {
+public:
+    DeviceWorker();
+    // Finishes any queued jobs first
+    ~DeviceWorker();
+
+    DeviceWorker(DeviceWorker const&) =delete;
+    DeviceWorker& operator=(DeviceWorker const&) =delete;
+
+    // Run `job` on the worker thread.  Anything it throws comes out of
+    // the future's get().
+    std::future<void> submit(std::function<void()> job);
+
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::packaged_task<void()>> jobs;
+    bool stopping;
+    std::thread thread;
+
+    void run();
+};
@@ -0,0 +1,80 @@
+#include <algorithm>
+
+#include "NrlPollScheduler.hh"
+
+namespace {
+constexpr double BANK_EVENTS = SipmUsb::FpgaLmNrl1::MAX_EVENTS;
+}
+
+NrlPollScheduler::NrlPollScheduler(Config config, clock::time_point start) :
+    config{config},
+    last_read{start},
+    rate{},
+    last_both_full{false},
+    both_full{0}
+{ }
+
+void NrlPollScheduler::record(clock::time_point now, Detector::NrlPollResult const& poll) {
+    double elapsed = std::chrono::duration<double>(now - last_read).count();
+
+    if (poll.banks_read > 0) {
+        if (elapsed > 0) {
+            double measured = poll.events / elapsed;
+            rate = rate
+                ? config.smoothing * measured + (1 - config.smoothing) * (*rate)
+                : measured;
+        }
+        last_read = now;
+    }
+    else if (rate && elapsed > 0) {
+        // nothing filled in all that time, so it can't be filling
+        // any faster than this
+        rate = std::min(*rate, BANK_EVENTS / elapsed);
+    }
+
+    last_both_full = poll.both_full;
+    if (poll.both_full) {
+        ++both_full;
+    }
+}
+
+std::chrono::milliseconds NrlPollScheduler::period() const {
+    if (last_both_full) {
+        return config.min_period;
+    }
+    if (!rate) {
+        return config.initial_period;
+    }
+    if (*rate <= 0) {
+        return config.max_period;
+    }
+
+    // clamped before converting, as a tiny rate makes for a huge period
+    double ms = 1000 * BANK_EVENTS / *rate / config.polls_per_bank;
+    ms = std::clamp<double>(ms, config.min_period.count(), config.max_period.count());
+    return std::chrono::milliseconds{static_cast<std::chrono::milliseconds::rep>(ms)};
+}
+
+std::optional<double> NrlPollScheduler::fill_rate() const {
+    return rate;
+}
+
+uint64_t NrlPollScheduler::both_full_count() const {
+    return both_full;
+}
+
+NrlPollDeadline next_nrl_poll(
+    NrlPollScheduler::clock::time_point last,
+    std::chrono::milliseconds period,
+    NrlPollScheduler::clock::time_point now)
+{
+    if (period <= std::chrono::milliseconds::zero()) {
+        return {.at = now, .skipped = 0};
+    }
+    auto next = last + period;
+    if (next >= now) {
+        return {.at = next, .skipped = 0};
+    }
+    uint64_t skipped = (now - next) / period + 1;
+    return {.at = next + skipped * period, .skipped = skipped};
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include <HafxControl.hh>
+
+struct NrlPollConfig {
+    // the poll period stays within these
+    std::chrono::milliseconds min_period{5};
+    std::chrono::milliseconds max_period{250};
+    // until there's a fill rate to go on
+    std::chrono::milliseconds initial_period{23};
+    // polls in the time it takes one bank to fill, so we get to a
+    // full bank well before the other one fills too
+    double polls_per_bank = 4;
+    // weight given to each new fill rate measurement
+    double smoothing = 0.5;
+};
+
+/*
+ * How often to poll one HaFX board's NRL banks.
+ *
+ * The board fills one 2047-event bank while we read the other; if
+ * the second fills before we've read the first, events are dropped.
+ * Each bank read gives a fill rate (events since the last read over
+ * the time since), smoothed over reads.  A long enough stretch with
+ * no bank full says the rate has dropped, so the period lengthens
+ * again when things quiet down.
+ *
+ * Finding both banks full means we were too slow: poll as fast as
+ * allowed until that stops.
+ */
+class NrlPollScheduler {
+public:
+    using clock = std::chrono::steady_clock;
+    using Config = NrlPollConfig;
+
+    // `start`: when list mode started, with both banks empty
+    NrlPollScheduler(Config config, clock::time_point start);
+
+    void record(clock::time_point now, Detector::NrlPollResult const& poll);
+
+    // How long until the next poll
+    std::chrono::milliseconds period() const;
+
+    // Events per second, once a bank has been read
+    std::optional<double> fill_rate() const;
+
+    // Polls that found both banks full (events may have been lost)
+    uint64_t both_full_count() const;
+
+private:
+    Config config;
+    // when a bank was last read, or list mode started
+    clock::time_point last_read;
+    std::optional<double> rate;
+    bool last_both_full;
+    uint64_t both_full;
+};
+
+struct NrlPollDeadline {
+    NrlPollScheduler::clock::time_point at;
+    // whole periods that had already gone by
+    uint64_t skipped;
+};
+
+// When the poll after one due at `last` is due: `period` on, on
+// absolute deadlines so the schedule doesn't slip by however long each
+// poll takes.  A deadline that is already past by `now` is skipped
+// rather than run late.
+NrlPollDeadline next_nrl_poll(
+    NrlPollScheduler::clock::time_point last,
+    std::chrono::milliseconds period,
+    NrlPollScheduler::clock::time_point now);
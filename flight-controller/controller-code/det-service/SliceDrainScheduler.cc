@@ -0,0 +1,33 @@
+#include <algorithm>
+
+#include "SliceDrainScheduler.hh"
+
+SliceDrainScheduler::SliceDrainScheduler(Config config) :
+    config{config},
+    longest{std::max(
+        config.min_interval,
+        std::chrono::milliseconds{1000 * config.high_water / std::max(config.slices_per_second, 1u)})},
+    current{longest},
+    overflows{0}
+{ }
+
+void SliceDrainScheduler::record(uint16_t waiting, bool overflowed) {
+    if (overflowed) {
+        ++overflows;
+    }
+
+    if (overflowed || waiting > config.high_water) {
+        current = std::max(current / 2, config.min_interval);
+    }
+    else if (waiting <= config.high_water / 2) {
+        current = std::min(current * 2, longest);
+    }
+}
+
+std::chrono::milliseconds SliceDrainScheduler::interval() const {
+    return current;
+}
+
+uint64_t SliceDrainScheduler::overflow_count() const {
+    return overflows;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+struct SliceDrainConfig {
+    // slices the boards make a second
+    unsigned slices_per_second = 32;
+    // drain before this many are waiting, out of
+    // FpgaResults::MAX_TIME_SLICES
+    uint16_t high_water = 96;
+    // the most often an early drain comes around
+    std::chrono::milliseconds min_interval{250};
+};
+
+/*
+ * When to drain the HaFX time slice FIFOs between nominal ticks.
+ *
+ * The boards hold at most 127 slices, about 4 s worth.  The nominal
+ * tick drains them every 2 s, but a slow tick (or a skipped one) can
+ * let them fill.  So after each drain, an early one is due by the time
+ * the FIFO would reach the high-water mark; a tick that comes first
+ * puts it off again.
+ *
+ * A drain that finds more than the high-water mark waiting, or finds
+ * slices lost, halves the interval, down to `min_interval`.  Drains
+ * with plenty of room double it back to the high-water time.
+ */
+class SliceDrainScheduler {
+public:
+    using Config = SliceDrainConfig;
+
+    explicit SliceDrainScheduler(Config config = {});
+
+    // A drain found `waiting` slices on the fullest board, and whether
+    // any board lost some
+    void record(uint16_t waiting, bool overflowed);
+
+    // How long after a drain the next one is due at the latest
+    std::chrono::milliseconds interval() const;
+
+    // Drains that found slices lost; logged when nominal stops
+    uint64_t overflow_count() const;
+
+private:
+    Config config;
+    // time to reach the high-water mark from empty
+    std::chrono::milliseconds longest;
+    std::chrono::milliseconds current;
+    uint64_t overflows;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+/*
+ * Bounded lock-free multi-producer/single-consumer ring buffer.
+ *
+ * Each slot carries a sequence number (D. Vyukov's bounded queue):
+ * producers claim a position with a CAS on `head`, fill the slot,
+ * then publish it by bumping the slot sequence.  The single consumer
+ * owns `tail` outright, so popping needs no read-modify-write at all.
+ *
+ * try_pop() must only ever be called from one thread at a time.
+ */
+template<typename T, size_t Capacity>
+class MpscRing {
+    static_assert(std::has_single_bit(Capacity), "capacity must be a power of two");
+    static constexpr size_t MASK = Capacity - 1;
+
+    // keep producer and consumer counters on separate cache lines
+    static constexpr size_t CACHE_LINE = 64;
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        std::optional<T> value;
+    };
+
+    // allocated once up front; never resized
+    std::unique_ptr<Slot[]> slots;
+    alignas(CACHE_LINE) std::atomic<size_t> head;
+    alignas(CACHE_LINE) size_t tail;
+
+public:
+    MpscRing()
+      : slots{std::make_unique<Slot[]>(Capacity)}
+      , head{0}
+      , tail{0}
+    {
+        for (size_t i = 0; i < Capacity; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(MpscRing const&) =delete;
+    MpscRing& operator=(MpscRing const&) =delete;
+
+    static constexpr size_t capacity() { return Capacity; }
+
+    // Returns false (and leaves `t` untouched) if the ring is full.
+    bool try_push(T& t) {
+        auto pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            auto& slot = slots[pos & MASK];
+            auto seq = slot.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                // slot is free for this lap; try to claim it
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value.emplace(std::move(t));
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+                // CAS failure reloaded `pos`; try again
+            }
+            else if (diff < 0) {
+                // consumer has not freed this slot yet
+                return false;
+            }
+            else {
+                // another producer got here first
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::optional<T> try_pop() {
+        auto& slot = slots[tail & MASK];
+        auto seq = slot.sequence.load(std::memory_order_acquire);
+        if (seq != tail + 1) {
+            // empty, or the producer hasn't finished publishing
+            return {};
+        }
+
+        auto ret = std::move(slot.value);
+        slot.value.reset();
+        // free the slot for the producers' next lap
+        slot.sequence.store(tail + Capacity, std::memory_order_release);
+        ++tail;
+        return ret;
+    }
+
+    // Only meaningful from the consumer thread.
+    bool empty() const {
+        auto seq = slots[tail & MASK].sequence.load(std::memory_order_acquire);
+        return seq != tail + 1;
+    }
+};
@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include <DevicePoller.hh>
+
+using namespace std::chrono_literals;
+using State = DeviceHealth::State;
+
+namespace {
+DeviceHealth::Config test_config() {
+    return DeviceHealth::Config{
+        .failures_to_quarantine = 3,
+        .retry_after = 100ms,
+        .max_retry_after = 350ms,
+    };
+}
+}
+
+TEST(DeviceHealth, QuarantineAfterRepeatedFailures) {
+    DeviceHealth h{test_config()};
+    auto t0 = DeviceHealth::clock::time_point{};
+
+    EXPECT_EQ(h.state(), State::healthy);
+    h.record_failure(t0);
+    EXPECT_EQ(h.state(), State::degraded);
+    EXPECT_TRUE(h.should_poll(t0));
+
+    // a success in between starts the count over
+    h.record_success();
+    EXPECT_EQ(h.state(), State::healthy);
+    h.record_failure(t0);
+    h.record_failure(t0);
+    EXPECT_EQ(h.state(), State::degraded);
+
+    h.record_failure(t0);
+    EXPECT_EQ(h.state(), State::quarantined);
+    EXPECT_FALSE(h.should_poll(t0 + 99ms));
+    EXPECT_TRUE(h.should_poll(t0 + 100ms));
+}
+
+TEST(DeviceHealth, RetryBackoffDoublesUpToLimit) {
+    DeviceHealth h{test_config()};
+    auto now = DeviceHealth::clock::time_point{};
+    for (int i = 0; i < 3; ++i) {
+        h.record_failure(now);
+    }
+
+    // failed retries: 200, 350 (capped), 350
+    for (auto wait : {200ms, 350ms, 350ms}) {
+        now += 100ms;
+        h.record_failure(now);
+        EXPECT_EQ(h.state(), State::quarantined);
+        EXPECT_FALSE(h.should_poll(now + wait - 1ms));
+        EXPECT_TRUE(h.should_poll(now + wait));
+    }
+
+    h.record_success();
+    EXPECT_EQ(h.state(), State::healthy);
+    EXPECT_EQ(h.consecutive_failures(), 0u);
+    EXPECT_TRUE(h.should_poll(now));
+}
+
+TEST(DeviceHealth, UnpluggedUntilArrival) {
+    DeviceHealth h{test_config()};
+    auto t0 = DeviceHealth::clock::time_point{};
+
+    h.record_departure();
+    EXPECT_EQ(h.state(), State::quarantined);
+    EXPECT_FALSE(h.should_poll(t0 + 24h));
+
+    // arrival doesn't wait out the backoff
+    h.record_arrival();
+    EXPECT_TRUE(h.should_poll(t0));
+    h.record_success();
+    EXPECT_EQ(h.state(), State::healthy);
+
+    // and leaves a healthy device alone
+    h.record_arrival();
+    EXPECT_EQ(h.state(), State::healthy);
+}
+
+TEST(DevicePoller, ErrorsAreRecordedNotThrown) {
+    DevicePoller p{"test board", test_config()};
+    auto now = DevicePoller::clock::now();
+
+    ASSERT_TRUE(p.start([]() { throw std::runtime_error{"usb timeout"}; }, now));
+    EXPECT_EQ(p.finish(now + 1s), DevicePoller::Outcome::failed);
+    EXPECT_EQ(p.health().state(), State::degraded);
+
+    ASSERT_TRUE(p.start([]() {}, now));
+    EXPECT_EQ(p.finish(now + 1s), DevicePoller::Outcome::ok);
+    EXPECT_EQ(p.health().state(), State::healthy);
+}
+
+TEST(DevicePoller, StalledDeviceDoesNotHoldUpThePoll) {
+    /*
+     * One board hangs for much longer than the budget; the poll has to
+     * come back at the deadline, and the board is skipped until its
+     * job finishes in the background.
+     */
+    DevicePoller stalled{"stalled", test_config()};
+    DevicePoller fine{"fine", test_config()};
+    std::atomic<bool> release{false};
+
+    auto start = DevicePoller::clock::now();
+    ASSERT_TRUE(stalled.start([&release]() {
+        while (!release) {
+            std::this_thread::sleep_for(1ms);
+        }
+    }, start));
+    ASSERT_TRUE(fine.start([]() {}, start));
+
+    auto deadline = start + 30ms;
+    EXPECT_EQ(stalled.finish(deadline), DevicePoller::Outcome::timed_out);
+    EXPECT_EQ(fine.finish(deadline), DevicePoller::Outcome::ok);
+    EXPECT_LT(DevicePoller::clock::now() - start, 200ms);
+    EXPECT_EQ(stalled.health().state(), State::degraded);
+
+    // next cycle: still stuck, so it's skipped without waiting
+    EXPECT_TRUE(stalled.busy());
+    EXPECT_FALSE(stalled.start([]() {}));
+    EXPECT_EQ(stalled.finish(DevicePoller::clock::now() + 1s), DevicePoller::Outcome::skipped);
+
+    release = true;
+    stalled.drain();
+    EXPECT_FALSE(stalled.busy());
+    // finishing late doesn't undo the failure ...
+    EXPECT_EQ(stalled.health().state(), State::degraded);
+    EXPECT_EQ(stalled.health().consecutive_failures(), 1u);
+    // ... but a poll in time does
+    EXPECT_TRUE(stalled.start([]() {}));
+    EXPECT_EQ(stalled.finish(DevicePoller::clock::now() + 1s), DevicePoller::Outcome::ok);
+}
+
+TEST(DevicePoller, AlwaysSlowDeviceIsQuarantined) {
+    DevicePoller slow{"slow", test_config()};
+    for (int i = 0; i < 3; ++i) {
+        auto now = DevicePoller::clock::now();
+        ASSERT_TRUE(slow.start([]() { std::this_thread::sleep_for(20ms); }, now));
+        EXPECT_EQ(slow.finish(now + 1ms), DevicePoller::Outcome::timed_out);
+        // every job does finish, just never in time
+        slow.drain();
+    }
+    EXPECT_EQ(slow.health().state(), State::quarantined);
+    EXPECT_FALSE(slow.start([]() {}));
+}
+
+TEST(DevicePoller, QuarantinedDeviceIsRetriedLater) {
+    DevicePoller p{"flaky", test_config()};
+    auto now = DevicePoller::clock::now();
+    auto fail = []() { throw std::runtime_error{"pipe error"}; };
+
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_TRUE(p.start(fail, now));
+        p.finish(now + 1s);
+    }
+    EXPECT_EQ(p.health().state(), State::quarantined);
+
+    int runs = 0;
+    auto count = [&runs]() { ++runs; };
+    EXPECT_FALSE(p.start(count, DevicePoller::clock::now()));
+    EXPECT_TRUE(p.start(count, DevicePoller::clock::now() + 100ms));
+    EXPECT_EQ(p.finish(DevicePoller::clock::now() + 1s), DevicePoller::Outcome::ok);
+    EXPECT_EQ(runs, 1);
+    EXPECT_EQ(p.health().state(), State::healthy);
+}
+
+int main(int argc, char *argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
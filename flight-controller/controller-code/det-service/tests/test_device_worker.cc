@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <DeviceWorker.hh>
+
+using namespace std::chrono_literals;
+
+TEST(DeviceWorker, RunsJobsInOrder) {
+    DeviceWorker w;
+    std::vector<int> order;
+    std::vector<std::future<void>> pending;
+    for (int i = 0; i < 5; ++i) {
+        pending.push_back(w.submit([&order, i]() { order.push_back(i); }));
+    }
+    for (auto& p : pending) {
+        p.get();
+    }
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 2, 3, 4}));
+}
+
+TEST(DeviceWorker, ExceptionComesOutOfFuture) {
+    DeviceWorker w;
+    auto f = w.submit([]() { throw std::runtime_error{"usb timeout"}; });
+    EXPECT_THROW(f.get(), std::runtime_error);
+
+    // worker is still usable afterwards
+    bool ran = false;
+    w.submit([&ran]() { ran = true; }).get();
+    EXPECT_TRUE(ran);
+}
+
+TEST(DeviceWorker, WorkersRunConcurrently) {
+    /*
+     * Four "boards" that each block for 50 ms should take about 50 ms
+     * together, not 200.
+     */
+    constexpr int NUM_WORKERS = 4;
+    std::vector<std::unique_ptr<DeviceWorker>> workers;
+    for (int i = 0; i < NUM_WORKERS; ++i) {
+        workers.push_back(std::make_unique<DeviceWorker>());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::future<void>> pending;
+    for (auto& w : workers) {
+        pending.push_back(w->submit([]() { std::this_thread::sleep_for(50ms); }));
+    }
+    for (auto& p : pending) {
+        p.get();
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 150ms);
+}
+
+TEST(DeviceWorker, DestructorFinishesQueuedJobs) {
+    std::atomic<int> done{0};
+    {
+        DeviceWorker w;
+        for (int i = 0; i < 10; ++i) {
+            w.submit([&done]() { ++done; });
+        }
+    }
+    EXPECT_EQ(done, 10);
+}
+
+int main(int argc, char *argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
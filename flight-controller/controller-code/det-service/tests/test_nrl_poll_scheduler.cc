@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <chrono>
+
+#include <NrlPollScheduler.hh>
+
+using namespace std::chrono_literals;
+
+namespace {
+const auto T0 = NrlPollScheduler::clock::time_point{};
+constexpr size_t BANK = SipmUsb::FpgaLmNrl1::MAX_EVENTS;
+
+NrlPollConfig test_config() {
+    return NrlPollConfig{
+        .min_period = 5ms,
+        .max_period = 250ms,
+        .initial_period = 23ms,
+        .polls_per_bank = 4,
+        .smoothing = 0.5,
+    };
+}
+
+Detector::NrlPollResult nothing_full() {
+    return {.banks_read = 0, .events = 0, .both_full = false};
+}
+
+Detector::NrlPollResult one_bank() {
+    return {.banks_read = 1, .events = BANK, .both_full = false};
+}
+}
+
+TEST(NrlPollScheduler, InitialPeriodUntilABankIsRead) {
+    NrlPollScheduler s{test_config(), T0};
+    EXPECT_EQ(s.period(), 23ms);
+    EXPECT_FALSE(s.fill_rate());
+
+    s.record(T0 + 23ms, nothing_full());
+    EXPECT_EQ(s.period(), 23ms);
+    EXPECT_FALSE(s.fill_rate());
+}
+
+TEST(NrlPollScheduler, PeriodFollowsFillRate) {
+    NrlPollScheduler s{test_config(), T0};
+
+    // a bank a second: a quarter second per poll, which is the most
+    s.record(T0 + 1s, one_bank());
+    ASSERT_TRUE(s.fill_rate());
+    EXPECT_DOUBLE_EQ(*s.fill_rate(), BANK);
+    EXPECT_EQ(s.period(), 250ms);
+
+    // a bank every 200 ms, smoothed in
+    s.record(T0 + 1200ms, one_bank());
+    EXPECT_DOUBLE_EQ(*s.fill_rate(), 0.5 * BANK + 0.5 * BANK / 0.2);
+    EXPECT_EQ(s.period(), 83ms);
+
+    // a flare: never shorter than the least
+    for (int i = 1; i <= 5; ++i) {
+        s.record(T0 + 1200ms + i * 10ms, one_bank());
+    }
+    EXPECT_EQ(s.period(), 5ms);
+}
+
+TEST(NrlPollScheduler, QuietSpellLengthensPeriod) {
+    NrlPollScheduler s{test_config(), T0};
+    s.record(T0 + 100ms, one_bank());
+    s.record(T0 + 200ms, one_bank());
+    EXPECT_EQ(s.period(), 25ms);
+
+    // polled at that rate, nothing filling
+    auto t = T0 + 200ms;
+    for (int i = 0; i < 40; ++i) {
+        t += s.period();
+        s.record(t, nothing_full());
+    }
+    EXPECT_EQ(s.period(), 250ms);
+    EXPECT_LE(*s.fill_rate(), BANK / 0.9);
+}
+
+TEST(NrlPollScheduler, BothFullPollsFastestUntilCaughtUp) {
+    NrlPollScheduler s{test_config(), T0};
+    s.record(T0 + 1s, one_bank());
+    ASSERT_EQ(s.period(), 250ms);
+
+    s.record(T0 + 1250ms, {.banks_read = 2, .events = 2 * BANK, .both_full = true});
+    EXPECT_EQ(s.period(), 5ms);
+    EXPECT_EQ(s.both_full_count(), 1u);
+
+    // caught up: back to what the rate says
+    s.record(T0 + 1255ms, nothing_full());
+    EXPECT_GT(s.period(), 5ms);
+    EXPECT_EQ(s.both_full_count(), 1u);
+}
+
+TEST(NrlPollScheduler, NoEventsAtAll) {
+    NrlPollScheduler s{test_config(), T0};
+    s.record(T0 + 1s, {.banks_read = 1, .events = 0, .both_full = false});
+    EXPECT_EQ(s.period(), 250ms);
+}
+
+TEST(NrlPollScheduler, DeadlinesDoNotDrift) {
+    // a poll that took a while still leaves the next one on the grid
+    auto next = next_nrl_poll(T0, 20ms, T0 + 7ms);
+    EXPECT_EQ(next.at, T0 + 20ms);
+    EXPECT_EQ(next.skipped, 0u);
+
+    next = next_nrl_poll(next.at, 50ms, T0 + 31ms);
+    EXPECT_EQ(next.at, T0 + 70ms);
+
+    // one that overran skips to the next deadline still ahead
+    next = next_nrl_poll(next.at, 10ms, T0 + 105ms);
+    EXPECT_EQ(next.at, T0 + 110ms);
+    EXPECT_EQ(next.skipped, 3u);
+}
+
+int main(int argc, char *argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+#include <chrono>
+
+#include <SliceDrainScheduler.hh>
+
+using namespace std::chrono_literals;
+
+TEST(SliceDrainScheduler, StartsAtHighWaterTime) {
+    SliceDrainScheduler s;
+    // 96 slices at 32 a second
+    EXPECT_EQ(s.interval(), 3000ms);
+    EXPECT_EQ(s.overflow_count(), 0u);
+}
+
+TEST(SliceDrainScheduler, BacklogShortensInterval) {
+    SliceDrainScheduler s;
+    s.record(100, false);
+    EXPECT_EQ(s.interval(), 1500ms);
+    EXPECT_EQ(s.overflow_count(), 0u);
+
+    // in between: stays put
+    s.record(60, false);
+    EXPECT_EQ(s.interval(), 1500ms);
+
+    // plenty of room again
+    s.record(20, false);
+    EXPECT_EQ(s.interval(), 3000ms);
+    s.record(20, false);
+    EXPECT_EQ(s.interval(), 3000ms);
+}
+
+TEST(SliceDrainScheduler, OverflowCountedAndBounded) {
+    SliceDrainScheduler s;
+    for (int i = 0; i < 10; ++i) {
+        s.record(127, true);
+    }
+    EXPECT_EQ(s.interval(), 250ms);
+    EXPECT_EQ(s.overflow_count(), 10u);
+
+    // lost slices shorten it even with the FIFO drained
+    SliceDrainScheduler t;
+    t.record(0, true);
+    EXPECT_EQ(t.interval(), 1500ms);
+}
+
+TEST(SliceDrainScheduler, NoSlicesPerSecond) {
+    SliceDrainScheduler s{{.slices_per_second = 0, .high_water = 96, .min_interval = 250ms}};
+    EXPECT_GE(s.interval(), 250ms);
+}
+
+int main(int argc, char *argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,297 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <thread_safe_queue.hh>
+
+using namespace std::chrono_literals;
+
+namespace {
+// hundreds digit is the priority class
+struct ByHundreds {
+    static constexpr size_t CLASSES = 3;
+    size_t operator()(int v) const { return static_cast<size_t>(v / 100); }
+};
+}
+
+TEST(ThreadSafeQueue, PushPopInOrder) {
+    ThreadSafeQueue<int> q;
+    for (int i = 0; i < 10; ++i) {
+        q.push(i);
+    }
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(q.pop(), i);
+    }
+}
+
+TEST(ThreadSafeQueue, PopTimeoutEmpty) {
+    ThreadSafeQueue<int> q;
+    EXPECT_FALSE(q.pop_timeout(0ms));
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(q.pop_timeout(20ms));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+}
+
+TEST(ThreadSafeQueue, PopWakesOnPushFromOtherThread) {
+    ThreadSafeQueue<int> q;
+    std::thread producer{[&q]() {
+        std::this_thread::sleep_for(10ms);
+        q.push(42);
+    }};
+    EXPECT_EQ(q.pop(), 42);
+    producer.join();
+}
+
+TEST(ThreadSafeQueue, ManyProducers) {
+    /*
+     * Several producers hammering the queue at once (more items than
+     * the ring holds) must not lose or duplicate anything.
+     */
+    constexpr int NUM_PRODUCERS = 4;
+    constexpr int PER_PRODUCER = 5000;
+    ThreadSafeQueue<int> q;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < NUM_PRODUCERS; ++p) {
+        producers.emplace_back([&q, p]() {
+            for (int i = 0; i < PER_PRODUCER; ++i) {
+                q.push(p * PER_PRODUCER + i);
+            }
+        });
+    }
+
+    std::set<int> seen;
+    for (int i = 0; i < NUM_PRODUCERS * PER_PRODUCER; ++i) {
+        seen.insert(q.pop());
+    }
+    for (auto& p : producers) {
+        p.join();
+    }
+
+    EXPECT_EQ(seen.size(), static_cast<size_t>(NUM_PRODUCERS * PER_PRODUCER));
+    EXPECT_FALSE(q.pop_timeout(0ms));
+}
+
+TEST(ThreadSafeQueue, ConsumerCanPushPastFullRing) {
+    /*
+     * A handler pushing to its own queue mustn't wait on itself when
+     * the ring is full; what doesn't fit still comes out in order.
+     */
+    constexpr int COUNT = 1000;
+    ThreadSafeQueue<int> q;
+    q.push(-1);
+    ASSERT_EQ(q.pop(), -1);
+
+    for (int i = 0; i < COUNT; ++i) {
+        q.push(i);
+    }
+    // another thread's pushes queue up behind the overflow
+    std::thread{[&q]() { q.push(COUNT); }}.join();
+
+    for (int i = 0; i <= COUNT; ++i) {
+        EXPECT_EQ(q.pop(), i);
+    }
+    EXPECT_FALSE(q.pop_timeout(0ms));
+}
+
+TEST(ThreadSafeQueue, PushDelay) {
+    ThreadSafeQueue<int> q;
+    auto start = std::chrono::steady_clock::now();
+    auto timer = TimerLifetime{q.push_delay(7, 20ms)};
+
+    EXPECT_EQ(q.pop(), 7);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+}
+
+TEST(ThreadSafeQueue, CancelledPushDelayNeverArrives) {
+    ThreadSafeQueue<int> q;
+    auto timer = TimerLifetime{q.push_delay(1, 10ms)};
+    timer.reset();
+    EXPECT_FALSE(timer);
+
+    EXPECT_FALSE(q.pop_timeout(50ms));
+}
+
+TEST(ThreadSafeQueue, FiredButUnpoppedTimerCanBeCancelled) {
+    ThreadSafeQueue<int> q;
+    auto timer = TimerLifetime{q.push_delay(1, 1ms)};
+    std::this_thread::sleep_for(10ms);
+    timer.reset();
+
+    EXPECT_FALSE(q.pop_timeout(0ms));
+}
+
+TEST(ThreadSafeQueue, PushDelayFromOtherThreadWakesSleepingPop) {
+    /*
+     * pop() is asleep with no deadline when another thread arms a
+     * timer; it has to notice the new deadline.
+     */
+    ThreadSafeQueue<int> q;
+    std::thread producer{[&q]() {
+        std::this_thread::sleep_for(10ms);
+        q.push_delay(3, 10ms);
+    }};
+    EXPECT_EQ(q.pop(), 3);
+    producer.join();
+}
+
+TEST(ThreadSafeQueue, HigherPriorityFirst) {
+    ThreadSafeQueue<int, ByHundreds> q;
+    q.push(200);
+    q.push(100);
+    q.push(0);
+    q.push(1);
+    EXPECT_EQ(q.pop(), 0);
+    EXPECT_EQ(q.pop(), 1);
+    EXPECT_EQ(q.pop(), 100);
+    EXPECT_EQ(q.pop(), 200);
+
+    // timers are ranked the same way
+    q.push(101);
+    auto timer = TimerLifetime{q.push_delay(2, 0ms)};
+    EXPECT_EQ(q.pop(), 2);
+    EXPECT_EQ(q.pop(), 101);
+}
+
+TEST(ThreadSafeQueue, LowPriorityIsNotStarved) {
+    ThreadSafeQueue<int, ByHundreds> q;
+    q.push(200);
+    for (int i = 0; i < 50; ++i) {
+        q.push(i);
+    }
+
+    // the low-priority value gets through after a bounded number of
+    // higher-priority ones, not after all 50
+    int position = 0;
+    while (q.pop() != 200) {
+        ++position;
+    }
+    EXPECT_LT(position, 50);
+    EXPECT_GE(position, 1);
+}
+
+TEST(TimerWheel, FiresInDeadlineOrder) {
+    using clock = TimerWheel<int>::clock;
+    auto t0 = clock::time_point{};
+    TimerWheel<int> wheel{t0};
+
+    // spread across every level of the wheel
+    std::vector<std::chrono::milliseconds> delays{
+        5000000ms, 3ms, 70ms, 1ms, 300000ms, 4100ms, 64ms, 63ms, 4096ms,
+        // past the horizon
+        40000000ms
+    };
+    for (size_t i = 0; i < delays.size(); ++i) {
+        wheel.arm(static_cast<int>(delays[i].count()), t0 + delays[i]);
+    }
+
+    std::vector<int> fired;
+    auto now = t0;
+    while (wheel.armed()) {
+        auto next = wheel.next_wakeup();
+        ASSERT_TRUE(next);
+        // wheel must never ask to be woken in the past
+        ASSERT_GE(*next, now);
+        now = *next;
+        wheel.advance(now);
+        while (auto v = wheel.pop_expired()) {
+            // ... and never fires early
+            EXPECT_GE(now - t0, std::chrono::milliseconds{*v});
+            EXPECT_LT(now - t0, std::chrono::milliseconds{*v} + 1ms);
+            fired.push_back(*v);
+        }
+    }
+
+    std::sort(delays.begin(), delays.end());
+    ASSERT_EQ(fired.size(), delays.size());
+    for (size_t i = 0; i < delays.size(); ++i) {
+        EXPECT_EQ(fired[i], delays[i].count());
+    }
+}
+
+TEST(TimerWheel, CancelAndReuse) {
+    using clock = TimerWheel<int>::clock;
+    auto t0 = clock::time_point{};
+    TimerWheel<int> wheel{t0};
+
+    // arm/cancel like the NRL poll does; the pool must not grow
+    auto now = t0;
+    for (int i = 0; i < 10000; ++i) {
+        auto h = wheel.arm(i, now + 23ms);
+        if (i % 2) {
+            EXPECT_TRUE(wheel.cancel(h));
+            // second cancel is a no-op
+            EXPECT_FALSE(wheel.cancel(h));
+        }
+        else {
+            now += 23ms;
+            wheel.advance(now);
+            EXPECT_EQ(wheel.pop_expired(), i);
+            // stale handle after firing
+            EXPECT_FALSE(wheel.cancel(h));
+        }
+    }
+    EXPECT_EQ(wheel.armed(), 0u);
+    EXPECT_EQ(wheel.pool_size(), 1u);
+    EXPECT_FALSE(wheel.next_wakeup());
+}
+
+TEST(ThreadSafeQueue, PeriodicCountsOverruns) {
+    ThreadSafeQueue<int> q;
+    auto start = std::chrono::steady_clock::now();
+    auto timer = TimerLifetime{q.push_periodic([]() { return 5; }, start + 10ms, 10ms)};
+
+    EXPECT_EQ(q.pop(), 5);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 10ms);
+    // a slow handler: the ticks it sat on are skipped, not queued
+    std::this_thread::sleep_for(55ms);
+    EXPECT_EQ(q.pop(), 5);
+    EXPECT_FALSE(q.pop_timeout(0ms));
+    EXPECT_GE(timer.take_overruns(), 4u);
+    EXPECT_EQ(timer.take_overruns(), 0u);
+
+    timer.reset();
+    EXPECT_FALSE(q.pop_timeout(30ms));
+}
+
+TEST(TimerWheel, PeriodicDoesNotDrift) {
+    using clock = TimerWheel<int>::clock;
+    auto t0 = clock::time_point{};
+    TimerWheel<int> wheel{t0};
+
+    auto h = wheel.arm_periodic([]() { return 1; }, t0 + 23ms, 23ms);
+    auto now = t0;
+    for (int i = 1; i <= 1000; ++i) {
+        now = *wheel.next_wakeup();
+        wheel.advance(now);
+        ASSERT_EQ(wheel.pop_expired(), 1);
+        EXPECT_EQ(now - t0, i * 23ms);
+        // each tick's work takes a while; the next one shouldn't move
+        now += 17ms;
+        wheel.advance(now);
+        EXPECT_FALSE(wheel.pop_expired());
+    }
+    EXPECT_EQ(wheel.take_overruns(h), 0u);
+
+    // miss two and a bit periods
+    now += 60ms;
+    wheel.advance(now);
+    EXPECT_EQ(wheel.pop_expired(), 1);
+    EXPECT_FALSE(wheel.pop_expired());
+    EXPECT_EQ(wheel.take_overruns(h), 2u);
+    // still on the original grid
+    EXPECT_EQ((*wheel.next_wakeup() - t0) % 23ms, clock::duration::zero());
+
+    EXPECT_TRUE(wheel.cancel(h));
+    EXPECT_FALSE(wheel.next_wakeup());
+}
+
+int main(int argc, char *argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
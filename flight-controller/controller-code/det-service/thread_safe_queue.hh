@@ -1,185 +1,387 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <mutex>
 #include <optional>
-#include <queue>
+#include <thread>
 #include <utility>
 
-#include <boost/asio.hpp>
+#include <mpsc_ring.hh>
+#include <timer_wheel.hh>
 
-struct ThreadSafeQueueException : std::runtime_error {
-  ThreadSafeQueueException(std::string const& what) : std::runtime_error(what) {};
-};
+class TimerOwner;
 
-// Wraps a Boost ASIO timer in a struct with a boolean indicating
-// whether the operation should be canceled.  The boost timer's
-// cancel() method cannot be used, because if the timer is expired at
-// the time of the cancel() call, it will be run regardless.
-class PushDelayTimer {
-  std::mutex mtx;
-  bool cancelled = false;
-  boost::asio::steady_timer timer;
+// Refers to one push_delay or push_periodic timer.  Copyable and does
+// not own the timer: dropping it lets the timer fire.  Wrap it in a
+// TimerLifetime to cancel on destruction.
+struct TimerHandle {
+  TimerOwner *owner = nullptr;
+  uint32_t index = 0;
+  uint32_t generation = 0;
+};
 
+// Whatever armed a timer (i.e. a ThreadSafeQueue).
+class TimerOwner {
 public:
-  PushDelayTimer(boost::asio::io_context &ctx)
-    : timer(ctx) {}
-
-  boost::asio::steady_timer &boost_timer() {
-    return timer;
-  }
-
-  void cancel() {
-    std::lock_guard guard(mtx);
-    cancelled = true;
-  }
-  bool is_cancelled() {
-    std::lock_guard guard(mtx);
-    return cancelled;
-  }
+  // Cancelling a timer that already fired (or was already cancelled)
+  // does nothing.
+  virtual void cancel_timer(TimerHandle handle) = 0;
+  // Ticks a periodic timer skipped since last asked; see TimerWheel.
+  virtual uint64_t take_timer_overruns(TimerHandle handle) = 0;
+protected:
+  ~TimerOwner() = default;
 };
 
 
-// Cancels a push_delay timer when destructed.  Use
-// TimerLifetime::create to create instances.
+// Cancels a timer when destructed or reset.  A default-constructed
+// TimerLifetime owns no timer and is false.
 class TimerLifetime {
-  std::shared_ptr<PushDelayTimer> timer;
+  TimerHandle handle;
 
 public:
+  TimerLifetime() = default;
+  explicit TimerLifetime(TimerHandle handle) : handle{handle} {}
+
+  TimerLifetime(TimerLifetime const&) =delete;
+  TimerLifetime &operator=(TimerLifetime const&) =delete;
+
+  TimerLifetime(TimerLifetime &&other) noexcept
+    : handle{std::exchange(other.handle, {})} {}
+  TimerLifetime &operator=(TimerLifetime &&other) noexcept {
+    if (this != &other) {
+      reset();
+      handle = std::exchange(other.handle, {});
+    }
+    return *this;
+  }
+
   // Cancel timer in destructor
   ~TimerLifetime() {
-    if (timer) {
-      timer->cancel();
+    reset();
+  }
+
+  void reset() {
+    if (handle.owner) {
+      handle.owner->cancel_timer(handle);
+      handle = {};
     }
   }
 
-  static std::unique_ptr<TimerLifetime>
-  create(std::shared_ptr<PushDelayTimer> timer) {
-    auto timer_lifetime = std::make_unique<TimerLifetime>();
-    timer_lifetime->timer = std::move(timer);
-    return timer_lifetime;
+  explicit operator bool() const {
+    return handle.owner != nullptr;
+  }
+
+  // For periodic timers: how many ticks were dropped because the
+  // consumer fell behind, since the last call.
+  uint64_t take_overruns() {
+    return handle.owner ? handle.owner->take_timer_overruns(handle) : 0;
   }
 };
 
 
+// Default for ThreadSafeQueue: everything in one FIFO class.
 template<typename T>
-class ThreadSafeQueue {
-  std::mutex mtx; // Locks the queue
-  std::queue<T> queue;
-
-  // Only one work item should be run at a time (e.g. call poll_one(),
-  // do not call poll()), so that the handler for one work item can
-  // easily cancel queued work items.
-  boost::asio::io_context ctx;
-
-  // Informs the context there is more work coming.  (So that
-  // ctx.run_one() does not return immediately.)
-  boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work;
-
-  void lock_and_push_value(T t) {
-    std::lock_guard guard(mtx);
-    queue.push(std::move(t));
-  }
-  std::optional<T> lock_and_pop_value() {
-    std::lock_guard guard(mtx);
-    if (!queue.size()) {
+struct SinglePriority {
+  static constexpr size_t CLASSES = 1;
+  size_t operator()(T const&) const { return 0; }
+};
+
+
+// `Classify` sorts values into priority classes: it has a static
+// CLASSES count and maps a T to 0 (popped first) .. CLASSES - 1.
+// Values within a class come out in FIFO order.
+template<typename T, typename Classify = SinglePriority<T>>
+class ThreadSafeQueue : public TimerOwner {
+  using clock = std::chrono::steady_clock;
+  static constexpr size_t CLASSES = Classify::CLASSES;
+  static_assert(CLASSES >= 1 && CLASSES <= 255);
+
+  // Once a waiting class has been passed over this many times for
+  // higher-priority values, it gets the next pop regardless.
+  static constexpr uint32_t STARVATION_LIMIT = 8;
+
+  // Pushed values go straight into a lock-free ring (one per class).
+  // Plenty of room for the handful of commands and timer ticks that
+  // are ever queued at once.  Another thread pushing to a full ring
+  // waits for the consumer to make room.
+  static constexpr size_t CAPACITY = 256;
+  std::array<MpscRing<T, CAPACITY>, CLASSES> rings;
+  Classify classify;
+
+  // The consumer can't wait for itself, so what it pushes to a full
+  // ring (e.g. from inside a handler) goes on a locked list instead,
+  // popped once the ring is empty.  While a class has anything there,
+  // every push to it does too, so the class stays FIFO.
+  std::mutex overflow_mtx;
+  std::array<std::deque<T>, CLASSES> overflow;
+  std::array<std::atomic<size_t>, CLASSES> overflow_size;
+  // whoever last called pop()/pop_timeout()
+  std::atomic<std::thread::id> consumer_id;
+
+  // How many pops each class has waited through (consumer only)
+  std::array<uint32_t, CLASSES> passed_over;
+
+  // push_delay/push_periodic timers.  Any thread may arm or cancel
+  // one, but only the consumer advances the wheel (inside pop), so a
+  // timer's value is popped in turn with everything else in its class
+  // and stays cancellable right up until it is popped.  Also guards
+  // `passed_over`.
+  std::mutex timer_mtx;
+  TimerWheel<T> timers;
+
+  // The consumer sleeps on park_cv when there is nothing to pop.
+  // `consumer_parked` is set while it is (about to be) asleep;
+  // producers only touch the mutex/condvar when it is set, so a push
+  // to a busy consumer costs one CAS and no allocation.
+  std::mutex park_mtx;
+  std::condition_variable park_cv;
+  std::atomic<bool> consumer_parked;
+
+  uint8_t class_of(T const& t) {
+    auto c = classify(t);
+    return static_cast<uint8_t>(c < CLASSES ? c : CLASSES - 1);
+  }
+
+  void enqueue(T t) {
+    auto c = class_of(t);
+    auto &ring = rings[c];
+    bool from_consumer = (std::this_thread::get_id() == consumer_id.load());
+    while (overflow_size[c].load() > 0 || !ring.try_push(t)) {
+      if (from_consumer || overflow_size[c].load() > 0) {
+        std::lock_guard guard(overflow_mtx);
+        overflow[c].push_back(std::move(t));
+        overflow_size[c].fetch_add(1);
+        return;
+      }
+      // The consumer drains the ring continuously, so this only
+      // spins if it is stuck in a long handler.
+      std::this_thread::yield();
+    }
+  }
+
+  std::optional<T> take_overflow(uint8_t c) {
+    if (overflow_size[c].load() == 0) {
       return {};
     }
-    auto t = std::move(queue.front());
-    queue.pop();
+    std::lock_guard guard(overflow_mtx);
+    auto t = std::move(overflow[c].front());
+    overflow[c].pop_front();
+    overflow_size[c].fetch_sub(1);
     return t;
   }
+
+  void wake_consumer() {
+    // Pairs with the fence in park: either we see the flag or the
+    // consumer sees our value (or timer).
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumer_parked.load() && consumer_parked.exchange(false)) {
+      std::lock_guard guard(park_mtx);
+      park_cv.notify_one();
+    }
+  }
+
+  // Due timers of a class go ahead of its ring.
+  std::optional<T> take_from(uint8_t c) {
+    auto fired = timers.pop_expired(c);
+    if (fired) {
+      return fired;
+    }
+    auto pushed = rings[c].try_pop();
+    if (pushed) {
+      return pushed;
+    }
+    return take_overflow(c);
+  }
+
+  bool class_waiting(uint8_t c) {
+    return timers.has_expired(c) || !rings[c].empty() || overflow_size[c].load() > 0;
+  }
+
+  // Fire any due timers, then take from the highest-priority class
+  // with something waiting, unless a lower one has been starved.
+  std::optional<T> take() {
+    std::lock_guard guard(timer_mtx);
+    timers.advance(clock::now());
+
+    for (uint8_t c = 1; c < CLASSES; ++c) {
+      if (passed_over[c] >= STARVATION_LIMIT) {
+        auto result = take_from(c);
+        passed_over[c] = 0;
+        if (result) {
+          return result;
+        }
+      }
+    }
+
+    for (uint8_t c = 0; c < CLASSES; ++c) {
+      auto result = take_from(c);
+      if (!result) {
+        continue;
+      }
+      passed_over[c] = 0;
+      for (uint8_t lower = c + 1; lower < CLASSES; ++lower) {
+        if (class_waiting(lower)) {
+          ++passed_over[lower];
+        }
+      }
+      return result;
+    }
+    return {};
+  }
+
+  bool rings_empty() {
+    for (size_t c = 0; c < CLASSES; ++c) {
+      if (!rings[c].empty() || overflow_size[c].load() > 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Sleep until a producer wakes us, the next timer is due, or `limit`
+  // passes.  Returns straight away if something arrived since the last
+  // take().
+  void park(std::optional<clock::time_point> limit) {
+    std::unique_lock lock(park_mtx);
+    consumer_parked.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Check again after flagging: closes the race with a producer
+    // (or push_delay) that ran before it could see the flag.
+    auto deadline = limit;
+    {
+      std::lock_guard guard(timer_mtx);
+      auto wakeup = timers.next_wakeup();
+      if (wakeup && (!deadline || *wakeup < *deadline)) {
+        deadline = wakeup;
+      }
+    }
+    if (!rings_empty() || (deadline && *deadline <= clock::now())) {
+      consumer_parked.store(false);
+      return;
+    }
+
+    auto woken = [this]() { return !consumer_parked.load(); };
+    if (deadline) {
+      park_cv.wait_until(lock, *deadline, woken);
+    }
+    else {
+      park_cv.wait(lock, woken);
+    }
+    consumer_parked.store(false);
+  }
 public:
   ThreadSafeQueue()
-    : ctx()
-    , work(boost::asio::make_work_guard(ctx)) {}
+    : rings()
+    , classify()
+    , overflow_mtx()
+    , overflow()
+    , overflow_size{}
+    , consumer_id{}
+    , passed_over{}
+    , timer_mtx()
+    , timers(clock::now())
+    , park_mtx()
+    , park_cv()
+    , consumer_parked{false} {}
+
+  ThreadSafeQueue(ThreadSafeQueue const&) =delete;
+  ThreadSafeQueue &operator=(ThreadSafeQueue const&) =delete;
 
-  // Push a value onto the queue.
+  // Push a value onto the queue.  Safe to call from any thread,
+  // including the consumer's (see `overflow`).
   void push(T t) {
-    // mutex is not required here because the io_context is already
-    // thread-safe
-    boost::asio::post(ctx, [this, t=std::move(t)]() mutable {
-      // mark as `mutable` for move-only types
-      lock_and_push_value(std::move(t));
-    });
+    enqueue(std::move(t));
+    wake_consumer();
   }
 
-  // Push a value onto the queue after a set delay.
+  // Push a value onto the queue after a set delay (rounded up to the
+  // next millisecond).  Safe to call from any thread.
   template<typename Ref, typename Period>
-  std::shared_ptr<PushDelayTimer> push_delay(T t, std::chrono::duration<Ref, Period> delay) {
-    auto timer = std::make_shared<PushDelayTimer>(ctx);
-    timer->boost_timer().expires_after(delay);
-
-    // By capturing a shared_ptr to the timer in this lambda
-    // expression, the timer is kept alive until the expression runs.
-    // Then the timer is destroyed.  (This is a fairly common pattern
-    // in ASIO, unfortunately).
-    timer->boost_timer().async_wait([this, timer, t=std::move(t)](auto error_code) mutable {
-      if (error_code == boost::asio::error::operation_aborted) {
-        return;
-      }
-      else if (error_code) {
-        // This should never be reached, according to
-        // https://www.boost.org/doc/libs/1_81_0/doc/html/boost_asio/reference/basic_waitable_timer/async_wait.html
-        throw ThreadSafeQueueException(error_code.message());
-      }
+  TimerHandle push_delay(T t, std::chrono::duration<Ref, Period> delay) {
+    // a non-positive delay is due straight away rather than on the
+    // next tick
+    auto deadline = (delay <= std::chrono::duration<Ref, Period>::zero())
+      ? clock::time_point::min()
+      : clock::now() + std::chrono::ceil<clock::duration>(delay);
+    auto c = class_of(t);
+    TimerHandle handle;
+    {
+      std::lock_guard guard(timer_mtx);
+      auto armed = timers.arm(std::move(t), deadline, c);
+      handle = TimerHandle{this, armed.index, armed.generation};
+    }
+    // the consumer may be asleep waiting on a later deadline
+    wake_consumer();
+    return handle;
+  }
 
-      if (timer->is_cancelled()) {
-        return;
-      }
+  // Push `make()` at `first` and then every `period`, on absolute
+  // deadlines, until cancelled.  If the consumer falls behind, late
+  // ticks are coalesced or skipped (never queued up) and counted; see
+  // TimerLifetime::take_overruns.  Safe to call from any thread.
+  template<typename Ref, typename Period>
+  TimerHandle push_periodic(
+    std::function<T()> make,
+    clock::time_point first,
+    std::chrono::duration<Ref, Period> period
+  ) {
+    // every tick is the same kind of message
+    auto c = class_of(make());
+    TimerHandle handle;
+    {
+      std::lock_guard guard(timer_mtx);
+      auto armed = timers.arm_periodic(
+        std::move(make), first, std::chrono::ceil<clock::duration>(period), c);
+      handle = TimerHandle{this, armed.index, armed.generation};
+    }
+    wake_consumer();
+    return handle;
+  }
 
-      lock_and_push_value(std::move(t));
-    });
+  void cancel_timer(TimerHandle handle) override {
+    std::lock_guard guard(timer_mtx);
+    timers.cancel({handle.index, handle.generation});
+  }
 
-    return timer;
+  uint64_t take_timer_overruns(TimerHandle handle) override {
+    std::lock_guard guard(timer_mtx);
+    return timers.take_overruns({handle.index, handle.generation});
   }
 
   // Block until a value is ready, and then return it.
   T pop() {
-    // Wait until an item is pushed to the queue.
-    auto result = lock_and_pop_value();
+    consumer_id.store(std::this_thread::get_id());
+    auto result = take();
     while (!result) {
-      ctx.run_one();
-      result = lock_and_pop_value();
+      park({});
+      result = take();
     }
     // Since while loop has exited, result must hold a value
     return std::move(*result);
   }
 
   // Block until a value is ready or until a specified timeout expries.
+  // A zero timeout returns whatever is ready right now (if anything).
   template<typename Ref, typename Period>
   std::optional<T> pop_timeout(std::chrono::duration<Ref, Period> timeout) {
-    // Must handle the zero-timeout (non-blocking) case and timeout
-    // case separately in Boost
-    auto result = std::optional<T> {};
-
-    // If timeout is zero, run all work that is immediately available
-    // and return a value from the queue (if any)
-    if (timeout == std::chrono::duration<Ref, Period>::zero()) {
-      while (!result) {
-        // poll_one returns the number of work items executed.  If zero,
-        // there are no more items that can be executed immediately, so
-        // break from the loop and return.
-        if (!ctx.poll_one()) {
-          break;
-        }
-        result = lock_and_pop_value();
-      }
+    consumer_id.store(std::this_thread::get_id());
+    auto result = take();
+    if (result || timeout <= std::chrono::duration<Ref, Period>::zero()) {
       return result;
     }
 
-    // If timeout is nonzero, run work until there is a value on the
-    // queue or until the timeout has expired
-    auto end_time_point = std::chrono::steady_clock::now() + timeout;
-    while (!result) {
-      // same as with poll_one above, but if zero is returned, the
-      // timeout has expired, so break from the loop and return.
-      if (!ctx.run_one_until(end_time_point)) {
-        break;
-      }
-      result = lock_and_pop_value();
+    auto end_time_point = clock::now() + std::chrono::ceil<clock::duration>(timeout);
+    while (!result && clock::now() < end_time_point) {
+      park(end_time_point);
+      result = take();
     }
     return result;
   }
 };
-
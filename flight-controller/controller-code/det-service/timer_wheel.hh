@@ -0,0 +1,427 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/*
+ * Hierarchical timer wheel (Varghese & Lauck) with 1 ms ticks.
+ *
+ * Four levels of 64 slots cover 64^4 ms (~4.6 hours); anything further
+ * out is parked in the last slot of the top level and re-filed when it
+ * cascades.  Timers live in a pool of reusable nodes linked into their
+ * slot with intrusive indices, so arming and cancelling are O(1) and
+ * don't allocate once the pool has grown to the peak number of live
+ * timers.
+ *
+ * Periodic timers run on absolute deadlines (first, first + period,
+ * ...), so the schedule doesn't slip by however long the consumer
+ * takes to get around to each tick.  A periodic timer only ever has
+ * one tick waiting to be popped: ticks that come due while one is
+ * still waiting, or that are already in the past when it's re-armed,
+ * are skipped and counted as overruns.
+ *
+ * Not thread-safe; ThreadSafeQueue guards it with a mutex.
+ */
+template<typename T>
+class TimerWheel {
+public:
+    using clock = std::chrono::steady_clock;
+    static constexpr auto TICK = std::chrono::milliseconds{1};
+
+    // Identifies one armed timer.  The generation makes handles to a
+    // node that has since fired or been reused harmless.
+    struct Handle {
+        uint32_t index;
+        uint32_t generation;
+    };
+
+    explicit TimerWheel(clock::time_point start = clock::now())
+        : start{start}
+        , current_tick{0}
+        , heads{}
+        , occupied{}
+        , expired_head{NIL}
+        , expired_tail{NIL}
+        , free_head{NIL}
+        , num_armed{0}
+    {
+        for (auto& level : heads) {
+            level.fill(NIL);
+        }
+        // enough for every timer DetectorService keeps at once
+        nodes.reserve(16);
+    }
+
+    // `priority` is an opaque tag for the caller; see pop_expired.
+    Handle arm(T t, clock::time_point deadline, uint8_t priority = 0) {
+        auto idx = allocate_node();
+        auto& n = nodes[idx];
+        n.value.emplace(std::move(t));
+        n.priority = priority;
+        n.expiry = tick_ceil(deadline);
+        file(idx);
+        ++num_armed;
+        return Handle{idx, n.generation};
+    }
+
+    // Fire `make()` at `first`, then every `period` after that (rounded
+    // up to a whole tick) until cancelled.
+    Handle arm_periodic(
+        std::function<T()> make,
+        clock::time_point first,
+        clock::duration period,
+        uint8_t priority = 0
+    ) {
+        auto idx = allocate_node();
+        auto& n = nodes[idx];
+        n.make = std::move(make);
+        n.priority = priority;
+        n.expiry = tick_ceil(first);
+        auto period_ticks = std::chrono::ceil<std::chrono::milliseconds>(period) / TICK;
+        n.period = std::max<uint64_t>(1, static_cast<uint64_t>(period_ticks));
+        n.overruns = 0;
+        file(idx);
+        ++num_armed;
+        return Handle{idx, n.generation};
+    }
+
+    // Number of ticks a periodic timer has skipped since the last call.
+    uint64_t take_overruns(Handle h) {
+        if (!valid(h)) {
+            return 0;
+        }
+        return std::exchange(nodes[h.index].overruns, 0);
+    }
+
+    // Returns true if the timer was removed before it could be popped.
+    bool cancel(Handle h) {
+        if (!valid(h)) {
+            return false;
+        }
+        unlink(h.index);
+        release_node(h.index);
+        --num_armed;
+        return true;
+    }
+
+    // Run the wheel up to `now`, moving every due timer onto the
+    // expired list.
+    void advance(clock::time_point now) {
+        auto target = tick_floor(now);
+        while (current_tick < target) {
+            if (!occupied[0]) {
+                // nothing can expire before the next level-0 wrap,
+                // so skip straight there
+                auto next_wrap = (current_tick | SLOT_MASK) + 1;
+                if (next_wrap > target) {
+                    current_tick = target;
+                    break;
+                }
+                current_tick = next_wrap - 1;
+            }
+            ++current_tick;
+
+            // going to a new block: refill the lower levels
+            // from the higher ones, highest first
+            for (size_t level = LEVELS - 1; level > 0; --level) {
+                if ((current_tick & block_mask(level)) == 0) {
+                    cascade(level, slot_of(current_tick, level));
+                }
+            }
+
+            auto slot = slot_of(current_tick, 0);
+            auto idx = heads[0][slot];
+            while (idx != NIL) {
+                auto next = nodes[idx].next;
+                unlink(idx);
+                push_expired(idx);
+                idx = next;
+            }
+        }
+    }
+
+    // Next value whose timer has fired, in expiry order.
+    std::optional<T> pop_expired() {
+        if (expired_head == NIL) {
+            return {};
+        }
+        return fire(expired_head);
+    }
+
+    // Same, but only looking at timers armed with `priority`.
+    std::optional<T> pop_expired(uint8_t priority) {
+        auto idx = find_expired(priority);
+        if (idx == NIL) {
+            return {};
+        }
+        return fire(idx);
+    }
+
+    bool has_expired(uint8_t priority) const {
+        return find_expired(priority) != NIL;
+    }
+
+    // Earliest time that advance() might have work to do.
+    // May be early (a cascade) but is never late.
+    std::optional<clock::time_point> next_wakeup() const {
+        if (expired_head != NIL) {
+            return time_of(current_tick);
+        }
+        if (num_armed == 0) {
+            return {};
+        }
+
+        auto earliest = std::numeric_limits<uint64_t>::max();
+        for (size_t level = 0; level < LEVELS; ++level) {
+            if (!occupied[level]) {
+                continue;
+            }
+            auto shift = level * SLOT_BITS;
+            auto block = current_tick >> shift;
+            // distance to the next occupied slot after the current one
+            auto rotated = std::rotr(occupied[level], static_cast<int>((block + 1) & SLOT_MASK));
+            auto ahead = static_cast<uint64_t>(std::countr_zero(rotated)) + 1;
+            earliest = std::min(earliest, (block + ahead) << shift);
+        }
+        return time_of(earliest);
+    }
+
+    size_t armed() const { return num_armed; }
+    // number of timer nodes ever allocated (live + reusable)
+    size_t pool_size() const { return nodes.size(); }
+
+private:
+    static constexpr uint32_t NIL = std::numeric_limits<uint32_t>::max();
+    static constexpr size_t SLOT_BITS = 6;
+    static constexpr size_t SLOTS = 1 << SLOT_BITS;
+    static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+    static constexpr size_t LEVELS = 4;
+
+    // where a node is linked; level/slot are only valid when `slotted`
+    enum class Where : uint8_t { free, slotted, expired };
+
+    struct Node {
+        // one-shot timers hold their value; periodic ones make a
+        // fresh one each tick
+        std::optional<T> value;
+        std::function<T()> make;
+        uint64_t expiry = 0;
+        // ticks between deadlines; 0 for one-shot timers
+        uint64_t period = 0;
+        uint64_t overruns = 0;
+        uint32_t generation = 0;
+        uint32_t prev = NIL;
+        uint32_t next = NIL;
+        Where where = Where::free;
+        uint8_t priority = 0;
+        uint8_t level = 0;
+        uint8_t slot = 0;
+    };
+
+    clock::time_point start;
+    uint64_t current_tick;
+    std::vector<Node> nodes;
+    std::array<std::array<uint32_t, SLOTS>, LEVELS> heads;
+    // bit i set <=> heads[level][i] is non-empty
+    std::array<uint64_t, LEVELS> occupied;
+    uint32_t expired_head;
+    uint32_t expired_tail;
+    uint32_t free_head;
+    size_t num_armed;
+
+    static constexpr uint64_t block_mask(size_t level) {
+        return (uint64_t{1} << (level * SLOT_BITS)) - 1;
+    }
+    static constexpr size_t slot_of(uint64_t tick, size_t level) {
+        return (tick >> (level * SLOT_BITS)) & SLOT_MASK;
+    }
+
+    uint64_t tick_floor(clock::time_point tp) const {
+        if (tp <= start) {
+            return 0;
+        }
+        return static_cast<uint64_t>((tp - start) / TICK);
+    }
+    uint64_t tick_ceil(clock::time_point tp) const {
+        if (tp <= start) {
+            return 0;
+        }
+        auto elapsed = tp - start;
+        auto ticks = static_cast<uint64_t>(elapsed / TICK);
+        // never fire early
+        return (elapsed % TICK == clock::duration::zero()) ? ticks : ticks + 1;
+    }
+    clock::time_point time_of(uint64_t tick) const {
+        return start + std::chrono::duration_cast<clock::duration>(tick * TICK);
+    }
+
+    bool valid(Handle h) const {
+        return h.index < nodes.size()
+            && nodes[h.index].generation == h.generation
+            && nodes[h.index].where != Where::free;
+    }
+
+    uint32_t allocate_node() {
+        if (free_head != NIL) {
+            auto idx = free_head;
+            free_head = nodes[idx].next;
+            nodes[idx].next = NIL;
+            return idx;
+        }
+        nodes.emplace_back();
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+
+    void release_node(uint32_t idx) {
+        auto& n = nodes[idx];
+        n.value.reset();
+        n.make = nullptr;
+        n.period = 0;
+        n.where = Where::free;
+        // outstanding handles to this node are now stale
+        ++n.generation;
+        n.prev = NIL;
+        n.next = free_head;
+        free_head = idx;
+    }
+
+    // Put a node in the slot matching its expiry (or on the
+    // expired list if it's already due).
+    void file(uint32_t idx) {
+        auto& n = nodes[idx];
+        if (n.expiry <= current_tick) {
+            push_expired(idx);
+            return;
+        }
+
+        size_t level = 0;
+        while (level < LEVELS) {
+            auto shift = level * SLOT_BITS;
+            if ((n.expiry >> shift) - (current_tick >> shift) < SLOTS) {
+                break;
+            }
+            ++level;
+        }
+
+        size_t slot;
+        if (level == LEVELS) {
+            // beyond the wheel's horizon: park it as far out as
+            // possible and re-file it when that slot cascades
+            level = LEVELS - 1;
+            slot = (slot_of(current_tick, level) + SLOT_MASK) & SLOT_MASK;
+        }
+        else {
+            slot = slot_of(n.expiry, level);
+        }
+
+        n.where = Where::slotted;
+        n.level = static_cast<uint8_t>(level);
+        n.slot = static_cast<uint8_t>(slot);
+        n.prev = NIL;
+        n.next = heads[level][slot];
+        if (n.next != NIL) {
+            nodes[n.next].prev = idx;
+        }
+        heads[level][slot] = idx;
+        occupied[level] |= (uint64_t{1} << slot);
+    }
+
+    void push_expired(uint32_t idx) {
+        auto& n = nodes[idx];
+        n.where = Where::expired;
+        n.next = NIL;
+        n.prev = expired_tail;
+        if (expired_tail != NIL) {
+            nodes[expired_tail].next = idx;
+        }
+        else {
+            expired_head = idx;
+        }
+        expired_tail = idx;
+    }
+
+    void unlink(uint32_t idx) {
+        auto& n = nodes[idx];
+        if (n.where == Where::slotted) {
+            if (n.prev != NIL) {
+                nodes[n.prev].next = n.next;
+            }
+            else {
+                heads[n.level][n.slot] = n.next;
+                if (n.next == NIL) {
+                    occupied[n.level] &= ~(uint64_t{1} << n.slot);
+                }
+            }
+            if (n.next != NIL) {
+                nodes[n.next].prev = n.prev;
+            }
+        }
+        else if (n.where == Where::expired) {
+            if (n.prev != NIL) {
+                nodes[n.prev].next = n.next;
+            }
+            else {
+                expired_head = n.next;
+            }
+            if (n.next != NIL) {
+                nodes[n.next].prev = n.prev;
+            }
+            else {
+                expired_tail = n.prev;
+            }
+        }
+        n.prev = NIL;
+        n.next = NIL;
+    }
+
+    // The expired list is only ever a handful of entries long
+    uint32_t find_expired(uint8_t priority) const {
+        auto idx = expired_head;
+        while (idx != NIL && nodes[idx].priority != priority) {
+            idx = nodes[idx].next;
+        }
+        return idx;
+    }
+
+    // Take the value of an expired node, then re-arm (periodic) or
+    // free (one-shot) it.
+    std::optional<T> fire(uint32_t idx) {
+        unlink(idx);
+        auto& n = nodes[idx];
+        if (n.period) {
+            // next deadline is relative to the last one, not to now
+            n.expiry += n.period;
+            if (n.expiry <= current_tick) {
+                auto missed = (current_tick - n.expiry) / n.period + 1;
+                n.expiry += missed * n.period;
+                n.overruns += missed;
+            }
+            file(idx);
+            return n.make();
+        }
+
+        auto ret = std::move(n.value);
+        release_node(idx);
+        --num_armed;
+        return ret;
+    }
+
+    void cascade(size_t level, size_t slot) {
+        auto idx = heads[level][slot];
+        heads[level][slot] = NIL;
+        occupied[level] &= ~(uint64_t{1} << slot);
+        while (idx != NIL) {
+            auto next = nodes[idx].next;
+            file(idx);
+            idx = next;
+        }
+    }
+};
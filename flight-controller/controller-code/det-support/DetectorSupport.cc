@@ -73,36 +73,48 @@ DataSaver::~DataSaver()
 }
 
 void DataSaver::add(std::span<unsigned char const> data) {
+    add_gather({data});
+}
+void DataSaver::add(std::span<char const> data) {
+  // Call unsigned char overload
+  add({reinterpret_cast<unsigned char const*>(data.data()), data.size()});
+}
+
+void DataSaver::add_gather(std::initializer_list<std::span<unsigned char const>> pieces) {
+    constexpr size_t MAX_PIECES = 8;
+    if (pieces.size() > MAX_PIECES) {
+        throw DetectorException{"Too many pieces to save at once"};
+    }
+
+    std::array<iovec, MAX_PIECES> iov;
+    size_t total = 0;
+    size_t n = 0;
+    for (auto const& p : pieces) {
+        // sendmsg doesn't write to these
+        iov[n++] = iovec{
+            .iov_base = const_cast<unsigned char*>(p.data()),
+            .iov_len = p.size()
+        };
+        total += p.size();
+    }
+
     // we must not receive more than 64 KiB per transfer
-    if (data.size() > std::numeric_limits<uint16_t>::max()) {
+    if (total > std::numeric_limits<uint16_t>::max()) {
         throw DetectorException{
             "Cannot save data larger than 64 KiB. "
             "Dest. port is: " + std::to_string(ntohs(destination.sin_port))
         };
     }
 
-    std::vector<char> to_send;
-    auto data_size = static_cast<uint16_t>(data.size());
-    to_send.resize(data_size);
-    std::memcpy(to_send.data(), data.data(), data_size);
-
-    constexpr socklen_t SOCKADDR_SZ = sizeof(sockaddr_in);
-    int ret = sendto(
-        sock_fd,
-        to_send.data(),
-        to_send.size(),
-        0,
-        (const sockaddr*)&destination,
-        SOCKADDR_SZ
-    );
-
-    if (ret < 0) {
+    msghdr msg{};
+    msg.msg_name = const_cast<sockaddr_in*>(&destination);
+    msg.msg_namelen = sizeof(sockaddr_in);
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = n;
+
+    if (sendmsg(sock_fd, &msg, 0) < 0) {
         throw DetectorException{std::string{"Sendto error: "} + strerror(errno)};
     }
 }
-void DataSaver::add(std::span<char const> data) {
-  // Call unsigned char overload
-  add({reinterpret_cast<unsigned char const*>(data.data()), data.size()});
-}
 
 } // namespace Detector
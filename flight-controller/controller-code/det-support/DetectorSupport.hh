@@ -3,19 +3,23 @@
 #include <cstring>
 #include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <stdexcept>
 #include <memory>
 #include <filesystem>
+#include <initializer_list>
 #include <fstream>
 #include <map>
 #include <queue>
 #include <span>
 #include <string>
 #include <sstream>
+#include <type_traits>
 #include <unordered_map>
 
 #include <logging.hh>
@@ -76,21 +80,40 @@ public:
 
     void add(std::span<unsigned char const> data);
     void add(std::span<char const> data);
+
+    // Send the pieces as one datagram, straight from where they are
+    // (one sendmsg; nothing is copied together first)
+    void add_gather(std::initializer_list<std::span<unsigned char const>> pieces);
 };
 
+// The bytes of a trivially copyable value, e.g. for DataSaver::add_gather
+template<typename T>
+std::span<unsigned char const> bytes_of(T const& t) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return {reinterpret_cast<unsigned char const*>(&t), sizeof(t)};
+}
+
 /*
  * For nominal science data, we want things to be well-aligned with files.
  * So this lets us save a fixed number of events per file and ensure that each
  * file starts with a data chunk that has a valid time.
+ *
+ * A blob is sent as soon as it holds `num_before_save`, so one block of
+ * that many, allocated up front, is all the storage it needs.
  * */
 template<class MessageT>
 class QueuedDataSaver {
 public:
     using msg_t = MessageT;
+    static_assert(std::is_trivially_copyable_v<msg_t>);
+
     QueuedDataSaver(unsigned short udp_port, size_t num_before_save) :
         ds{std::make_unique<DataSaver>(udp_port)},
-        data_blob{},
-        num_before_save{num_before_save}
+        num_before_save{std::max<size_t>(num_before_save, 1)},
+        // not cleared: every slot is written before it's sent
+        data_blob{new msg_t[this->num_before_save]},
+        num_queued{0},
+        slot_open{false}
     { }
 
     ~QueuedDataSaver()
@@ -98,14 +121,41 @@ public:
 
     // returns false if data is not added
     bool add(msg_t const& m) {
-        bool skip_data_piece = (data_blob.empty() && m.time_anchor < 1);
+        bool skip_data_piece = (num_queued == 0 && m.time_anchor < 1);
         if (skip_data_piece) {
             return false;
         }
 
-        data_blob.push_back(m);
+        data_blob[num_queued++] = m;
+
+        if (num_queued >= num_before_save) {
+            save_blob();
+        }
+
+        return true;
+    }
+
+    // Where the next message goes, to be written in place instead of
+    // copied in with add().  It starts out as garbage, and isn't part
+    // of the queue until commit_slot(); add nothing else until then.
+    msg_t& next_slot() {
+        slot_open = true;
+        return data_blob[num_queued];
+    }
+
+    // add() for the message written into next_slot()
+    bool commit_slot() {
+        if (!slot_open) {
+            return false;
+        }
+        slot_open = false;
+
+        bool skip_data_piece = (num_queued == 0 && data_blob[0].time_anchor < 1);
+        if (skip_data_piece) {
+            return false;
+        }
 
-        if (data_blob.size() >= num_before_save) {
+        if (++num_queued >= num_before_save) {
             save_blob();
         }
 
@@ -114,21 +164,24 @@ public:
 
 private:
     std::unique_ptr<DataSaver> ds;
-    std::vector<msg_t> data_blob;
     size_t num_before_save;
+    std::unique_ptr<msg_t[]> data_blob;
+    size_t num_queued;
+    // next_slot() has handed out data_blob[num_queued]
+    bool slot_open;
 
     void save_blob() {
+        // The next blob starts over at the front, and its first
+        // message has to carry a time anchor again (see add()).
+        // Before sending: if the send throws, this blob is lost, but
+        // the saver has to stay usable (and within data_blob).
+        num_queued = 0;
+
         auto num_bytes = num_before_save * sizeof(msg_t);
         ds->add({
-          reinterpret_cast<unsigned char*>(data_blob.data()),
+          reinterpret_cast<unsigned char*>(data_blob.get()),
           num_bytes
         });
-
-        // if we have added another timestamped piece of data,
-        // this will put it at the front
-        // if there are only `num_before_save` pieces of data,
-        // the iterators will be equal and nothing will be copied (begin + nbs == end)
-        data_blob = std::vector<msg_t>(data_blob.begin() + num_before_save, data_blob.end());
     }
 };
 
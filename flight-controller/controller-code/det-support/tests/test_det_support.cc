@@ -1,9 +1,37 @@
+#include <atomic>
+#include <cstdlib>
 #include <memory>
+#include <new>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <DetectorSupport.hh>
 #include <DetectorMessages.hh>
 
+// Every allocation in the test binary, so a test can check that some
+// code path makes none
+namespace {
+std::atomic<size_t> allocations{0};
+}
+
+// None of these are inlined: GCC would then see malloc() and free()
+// paired with new and delete, and flag them (-Wmismatched-new-delete)
+[[gnu::noinline]] void* operator new(std::size_t n) {
+    ++allocations;
+    if (void* p = std::malloc(n ? n : 1)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+[[gnu::noinline]] void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
 TEST(DetSupport, ReadWriteX123Struct) {
     Detector::SettingsSaver saver{"test-x123.bin"};
 
@@ -36,6 +64,141 @@ TEST(DetSupport, ReadWriteX123Struct) {
     SUCCEED();
 }
 
+namespace {
+// Bound to 127.0.0.1:port; doesn't block
+int receiver(unsigned short port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr = {.s_addr = inet_addr("127.0.0.1")},
+        .sin_zero = {0}
+    };
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        throw std::runtime_error{"can't bind receiver"};
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+std::vector<std::vector<unsigned char>> receive_all(int fd) {
+    std::vector<std::vector<unsigned char>> ret;
+    std::vector<unsigned char> buf(65536);
+    ssize_t n;
+    while ((n = recv(fd, buf.data(), buf.size(), 0)) >= 0) {
+        ret.emplace_back(buf.begin(), buf.begin() + n);
+    }
+    return ret;
+}
+}
+
+TEST(DetSupport, QueuedAddsAllMatch) {
+    using msg_t = DetectorMessages::HafxNominalSpectrumStatus;
+    constexpr unsigned short ONE_PORT = 61010, SLOT_PORT = 61012;
+    int one_fd = receiver(ONE_PORT);
+    int slot_fd = receiver(SLOT_PORT);
+
+    // starts mid-second, with no anchor: those are skipped
+    std::vector<msg_t> slices(100);
+    uint32_t anchor = 1000;
+    for (size_t i = 0; i < slices.size(); ++i) {
+        auto bn = static_cast<uint16_t>((i + 29) % 32);
+        slices[i].buffer_number = bn;
+        slices[i].num_evts = static_cast<uint32_t>(i);
+        slices[i].time_anchor = (bn == 0) ? anchor++ : 0;
+    }
+
+    size_t added = 0;
+    {
+        Detector::QueuedDataSaver<msg_t> one{ONE_PORT, 32};
+        for (auto const& s : slices) {
+            added += one.add(s);
+        }
+        // written in place
+        Detector::QueuedDataSaver<msg_t> slot{SLOT_PORT, 32};
+        size_t slotted = 0;
+        for (auto const& s : slices) {
+            auto& m = slot.next_slot();
+            std::memcpy(&m, &s, sizeof(m));
+            slotted += slot.commit_slot();
+        }
+        EXPECT_EQ(slotted, 97u);
+    }
+    EXPECT_EQ(added, 97u);
+
+    auto from_one = receive_all(one_fd);
+    ASSERT_EQ(from_one.size(), 3u);
+    EXPECT_EQ(from_one, receive_all(slot_fd));
+    for (auto const& d : from_one) {
+        ASSERT_EQ(d.size(), 32 * sizeof(msg_t));
+        msg_t first;
+        std::memcpy(&first, d.data(), sizeof(first));
+        EXPECT_GT(first.time_anchor, 0u);
+    }
+
+    close(one_fd);
+    close(slot_fd);
+}
+
+TEST(DetSupport, QueuedSaverSteadyStateDoesNotAllocate) {
+    using msg_t = DetectorMessages::HafxNominalSpectrumStatus;
+    constexpr unsigned short PORT = 61013;
+    int fd = receiver(PORT);
+    Detector::QueuedDataSaver<msg_t> qds{PORT, 32};
+
+    msg_t slice{};
+    auto before = allocations.load();
+    // starts mid-second; each way of adding, over several blobs
+    for (uint32_t i = 0; i < 10 * 32 + 5; ++i) {
+        slice.buffer_number = static_cast<uint16_t>((i + 20) % 32);
+        slice.time_anchor = (slice.buffer_number == 0) ? 1000 + i : 0;
+        if (i % 2 == 0) {
+            qds.add(slice);
+        }
+        else {
+            qds.next_slot() = slice;
+            qds.commit_slot();
+        }
+    }
+    EXPECT_EQ(allocations.load() - before, 0u);
+
+    // and every blob still starts on a time anchor
+    auto blobs = receive_all(fd);
+    EXPECT_EQ(blobs.size(), 9u);
+    for (auto const& d : blobs) {
+        ASSERT_EQ(d.size(), 32 * sizeof(msg_t));
+        msg_t first;
+        std::memcpy(&first, d.data(), sizeof(first));
+        EXPECT_GT(first.time_anchor, 0u);
+        EXPECT_EQ(first.buffer_number, 0);
+    }
+    close(fd);
+}
+
+TEST(DetSupport, QueuedSaverUsableAfterSendFails) {
+    using msg_t = DetectorMessages::HafxNominalSpectrumStatus;
+    // too big for one datagram, so every send throws
+    constexpr size_t PER_BLOB = 200;
+    static_assert(PER_BLOB * sizeof(msg_t) > 65535);
+    Detector::QueuedDataSaver<msg_t> qds{61014, PER_BLOB};
+
+    msg_t slice{};
+    for (int round = 0; round < 3; ++round) {
+        for (size_t i = 0; i < PER_BLOB - 1; ++i) {
+            slice.time_anchor = (i == 0) ? 1000 : 0;
+            ASSERT_TRUE(qds.add(slice));
+        }
+        // the blob fills and can't be sent
+        EXPECT_THROW(qds.add(slice), DetectorException);
+
+        // dropped, and the saver starts a new blob: no anchor, no add
+        slice.time_anchor = 0;
+        EXPECT_FALSE(qds.add(slice));
+        qds.next_slot() = slice;
+        EXPECT_FALSE(qds.commit_slot());
+    }
+}
+
 int main(int argc, char *argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
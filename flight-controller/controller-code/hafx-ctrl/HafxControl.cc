@@ -1,5 +1,7 @@
 #include <HafxControl.hh>
 #include <logging.hh>
+#include <Widen.hh>
+#include <algorithm>
 #include <sstream>
 
 namespace Detector
@@ -10,13 +12,26 @@ HafxControl::HafxControl(std::shared_ptr<SipmUsb::UsbManager> driver_, DetectorP
     driver{driver_},
     settings_saver{driver->get_arm_serial() + ".bin"},
     science_time_anchor{},
+    science_port{ports.science},
+    science_ch{DetectorMessages::HafxChannel::C1},
+    slice_format{TimeSliceFormat::nominal},
     // christ that's a long line
     science_saver{std::make_unique<
                   QueuedDataSaver<
                   DetectorMessages::HafxNominalSpectrumStatus> >(
                   ports.science, SLICES_PER_SECOND)},
+    compact_saver{},
     nrl_data_saver{std::make_unique<DataSaver>(ports.science)}, // will need different udp capture flags than time slice nominal
-    debug_saver{std::make_unique<DataSaver>(ports.debug)}
+    debug_saver{std::make_unique<DataSaver>(ports.debug)},
+    nrl_buffer{std::make_unique<SipmUsb::FpgaLmNrl1>()},
+    nrl_flags{},
+    last_nrl_poll{},
+    nrl_next_bank{0},
+    nrl_stats{},
+    last_buffer_number{},
+    slices_lost{false},
+    last_time_slice_poll{},
+    time_slice_batch{std::make_unique<TimeSliceBatch>()}
 { }
 
 DetectorMessages::HafxHealth HafxControl::generate_health() {
@@ -50,6 +65,10 @@ DetectorMessages::HafxHealth HafxControl::generate_health() {
 void HafxControl::restart_time_slice_or_histogram() {
     using namespace SipmUsb;
     driver->write(FPGA_ACTION_START_NEW_HISTOGRAM_ACQUISITION, MemoryType::ram);
+
+    last_buffer_number.reset();
+    slices_lost = false;
+    last_time_slice_poll.reset();
 }
 
 void HafxControl::restart_list_mode() {
@@ -61,6 +80,12 @@ void HafxControl::restart_list_mode() {
     (void) this->read_nrl_buffer();
     this->swap_nrl_buffer(1);
     (void) this->read_nrl_buffer();
+    // the board fills bank 0 first: be ready to read it
+    this->swap_nrl_buffer(0);
+    nrl_next_bank = 0;
+    nrl_stats = {};
+    nrl_flags = {};
+    last_nrl_poll.reset();
 }
 
 void HafxControl::restart_trace() {
@@ -69,54 +94,177 @@ void HafxControl::restart_trace() {
 }
 
 bool HafxControl::check_trace_done() {
-    using namespace SipmUsb;
-    FpgaResults res{};
+    return read_status().trace_done();
+}
+
+SipmUsb::FpgaResults HafxControl::read_status() {
+    SipmUsb::FpgaResults res{};
     driver->read(res, SipmUsb::MemoryType::ram);
-    return res.trace_done();
+    return res;
 }
 
 std::optional<time_t> HafxControl::data_time_anchor() const {
     return science_time_anchor;
 }
 
+void HafxControl::reconnect(size_t pipeline_depth) {
+    auto sn = driver->get_arm_serial();
+    // our own claim would hide the board if it never dropped off the bus
+    driver->close();
+
+    SipmUsb::BridgeportDeviceManager found{pipeline_depth, sn};
+    if (!found.device_map.contains(sn)) {
+        throw DetectorException{"HaFX " + sn + " not found on the bus"};
+    }
+    driver = found.device_map.at(sn);
+    // it may have lost power in between
+    fpga_ctrl_shadow.reset();
+    log_info("HaFX " + sn + " reconnected");
+}
+
+std::optional<LibUsbCpp::UsbLocation> HafxControl::usb_location() const {
+    return driver->location();
+}
+
+SipmUsb::NrlFlagCounts HafxControl::nrl_flag_counts() const {
+    return nrl_flags;
+}
+
+std::optional<NrlPollResult> HafxControl::take_nrl_poll() {
+    return std::exchange(last_nrl_poll, std::nullopt);
+}
+
+std::array<NrlBankStats, 2> HafxControl::nrl_bank_stats() const {
+    return nrl_stats;
+}
+
+std::optional<TimeSlicePollResult> HafxControl::take_time_slice_poll() {
+    return std::exchange(last_time_slice_poll, std::nullopt);
+}
+
 void HafxControl::data_time_anchor(std::optional<time_t> new_anchor) {
     science_time_anchor = new_anchor;
 }
 
-void HafxControl::poll_save_time_slice() {
-    using namespace SipmUsb;
+void HafxControl::science_channel(DetectorMessages::HafxChannel ch) {
+    science_ch = ch;
+}
 
-    FpgaResults fpga_res_con;
-    driver->read(fpga_res_con, MemoryType::ram);
-    auto avail = fpga_res_con.num_avail_time_slices();
+void HafxControl::time_slice_format(TimeSliceFormat format) {
+    if (format == slice_format) {
+        return;
+    }
+    slice_format = format;
+
+    // a fresh queue, so no blob mixes the two
+    science_saver.reset();
+    compact_saver.reset();
+    if (format == TimeSliceFormat::compact) {
+        compact_saver = std::make_unique<QueuedDataSaver<compact_t>>(science_port, SLICES_PER_SECOND);
+    }
+    else {
+        science_saver = std::make_unique<QueuedDataSaver<science_t>>(science_port, SLICES_PER_SECOND);
+    }
+}
 
-    for (uint16_t i = 0; i < avail; ++i) {
-        // don't save the initial bad reads when the time anchor is invalid
-        if (!science_time_anchor) {
-            log_warning("anchor invalid for " + driver->get_arm_serial());
-            continue;
+TimeSliceFormat HafxControl::time_slice_format() const {
+    return slice_format;
+}
+
+template<class SaverT>
+bool HafxControl::save_time_slices(SaverT& saver, std::span<const SipmUsb::FpgaTimeSlice> raw) {
+    bool overflowed = false;
+    for (auto const& r : raw) {
+        auto& slice = saver.next_slot();
+        pack_time_slice(r, *science_time_anchor, slice);
+        slice.ch = static_cast<uint8_t>(science_ch);
+
+        auto bn = slice.buffer_number;
+        if (last_buffer_number && !time_slice_follows(*last_buffer_number, bn)) {
+            overflowed = true;
+            slices_lost = true;
         }
-        auto nominal = read_time_slice();
-        science_saver->add(nominal);
+        last_buffer_number = bn;
+
+        if constexpr (requires { slice.slices_lost; }) {
+            slice.slices_lost = std::exchange(slices_lost, false);
+        }
+        saver.commit_slot();
     }
+    return overflowed;
 }
 
-DetectorMessages::HafxNominalSpectrumStatus
-HafxControl::read_time_slice() {
+void HafxControl::poll_save_time_slice() {
+    poll_save_time_slice(read_status());
+}
+
+void HafxControl::poll_save_time_slice(SipmUsb::FpgaResults const& status) {
     using namespace SipmUsb;
-    // decode data from this to save it
-    FpgaTimeSlice time_slice_con;
-    driver->read(time_slice_con, MemoryType::ram);
+    auto avail = status.num_avail_time_slices();
+    bool overflowed = false;
+
+    // don't save the initial bad reads when the time anchor is invalid
+    if (avail > 0 && !science_time_anchor) {
+        log_warning("anchor invalid for " + driver->get_arm_serial());
+    }
+    else if (avail > 0) {
+        // All of them back to back, then packed straight into the
+        // science queue
+        size_t n = std::min<size_t>(avail, time_slice_batch->size());
+        auto raw = std::span{*time_slice_batch}.first(n);
+        driver->read_each(raw, MemoryType::ram);
+
+        overflowed = (slice_format == TimeSliceFormat::compact)
+            ? save_time_slices(*compact_saver, raw)
+            : save_time_slices(*science_saver, raw);
+    }
+
+    // A full FIFO has been dropping whatever came in since it filled,
+    // which is after what we just read.  That gap is the one the next
+    // read would find, so don't count it twice.
+    if (avail >= FpgaResults::MAX_TIME_SLICES) {
+        overflowed = true;
+        slices_lost = true;
+        last_buffer_number.reset();
+    }
+    if (overflowed) {
+        log_warning("time slices lost on " + driver->get_arm_serial());
+    }
+
+    last_time_slice_poll = TimeSlicePollResult{.waiting = avail, .overflowed = overflowed};
+}
+
+namespace {
+// start of chunk of 32 slices -- the timestamp, which moves on;
+// else zero
+uint32_t take_time_anchor(uint16_t buffer_number, time_t& anchor) {
+    if ((buffer_number % 32) != 0) {
+        return 0;
+    }
+    return static_cast<uint32_t>(anchor++);
+}
+}
 
-    const auto decoded = time_slice_con.decode();
+bool time_slice_follows(uint16_t last, uint16_t next) {
+    // Buffer numbers count up, and start over at 0 with the PPS after
+    // slice 31 (later if a PPS was missed).  Back to 0 any sooner
+    // means the rest of that second went missing.
+    if (next == 0) {
+        return last + 1u >= SLICES_PER_SECOND;
+    }
+    return next == last + 1u;
+}
+
+DetectorMessages::HafxNominalSpectrumStatus
+pack_time_slice(SipmUsb::DecodedTimeSlice const& decoded, time_t& anchor) {
     DetectorMessages::HafxNominalSpectrumStatus ret{};
     std::memset(&ret, 0, sizeof(ret));
 
     // start of chunk of 32 slices -- save the timestamp
     // else leave it zero
     if ((decoded.buffer_number % 32) == 0) {
-        ret.time_anchor = *science_time_anchor;
-        ++(*science_time_anchor);
+        ret.time_anchor = anchor;
+        ++anchor;
     }
 
     // if buffer number rolls over to 32 onward,
@@ -136,94 +284,203 @@ HafxControl::read_time_slice() {
     return ret;
 }
 
+void pack_time_slice(
+    SipmUsb::FpgaTimeSlice const& raw, time_t& anchor,
+    DetectorMessages::HafxNominalSpectrumStatus& out)
+{
+    // register layout as in FpgaTimeSlice::decode
+    auto const& regs = raw.registers;
+    uint16_t bn = regs[0];
+
+    out.ch = 0;
+    out.buffer_number = bn;
+    out.num_evts = regs[1];
+    out.num_triggers = regs[2];
+    out.dead_time = regs[3];
+    out.anode_current = regs[4];
+    // the histogram isn't aligned in the packed struct
+    using science_t = DetectorMessages::HafxNominalSpectrumStatus;
+    constexpr size_t NUM_BINS = sizeof(science_t::histogram) / sizeof(uint32_t);
+    SipmUsb::widen_u16_to_u32(
+        std::span{regs}.subspan<5, NUM_BINS>(),
+        reinterpret_cast<unsigned char*>(&out) + offsetof(science_t, histogram));
+
+    out.time_anchor = take_time_anchor(bn, anchor);
+    out.missed_pps = (bn > 31);
+}
+
+void pack_time_slice(
+    SipmUsb::FpgaTimeSlice const& raw, time_t& anchor,
+    DetectorMessages::HafxCompactSpectrumStatus& out)
+{
+    using compact_t = DetectorMessages::HafxCompactSpectrumStatus;
+    auto const& regs = raw.registers;
+    uint16_t bn = regs[0];
+
+    out.version = compact_t::VERSION_1;
+    out.ch = 0;
+    out.buffer_number = bn;
+    out.num_evts = regs[1];
+    out.num_triggers = regs[2];
+    out.dead_time = regs[3];
+    out.anode_current = regs[4];
+    // same widths as the registers: a straight copy
+    std::memcpy(
+        reinterpret_cast<unsigned char*>(&out) + offsetof(compact_t, histogram),
+        regs.data() + 5,
+        sizeof(compact_t::histogram));
+
+    out.time_anchor = take_time_anchor(bn, anchor);
+    out.missed_pps = (bn > 31);
+    out.slices_lost = false;
+}
+
+SipmUsb::FpgaCtrl& HafxControl::fpga_ctrl() {
+    if (!fpga_ctrl_shadow) {
+        fpga_ctrl_shadow.emplace();
+        driver->read(*fpga_ctrl_shadow, SipmUsb::MemoryType::ram);
+    }
+    return *fpga_ctrl_shadow;
+}
+
 void HafxControl::swap_nrl_buffer(uint8_t buf_num) {
     using namespace SipmUsb;
 
-    FpgaCtrl cont;
-    // read out current Fpga Ctrl registers
-    driver->read(cont, MemoryType::nvram);
-    // update buffer number
+    // Working registers only: which bank gets read out doesn't need
+    // to survive a power cycle, and writing NVRAM each swap wears out
+    // the flash.
+    auto& cont = fpga_ctrl();
     auto reg = cont.registers[15];
     // set bit 2 to 0 for bank 0,
     //           to 1 for bank 1
     reg = (buf_num == 0)? (reg & ~4) : (reg | 4);
     cont.registers[15] = reg;
 
-    driver->write(cont, MemoryType::nvram);
+    try {
+        driver->write(cont, MemoryType::ram);
+    }
+    catch (...) {
+        // don't know what made it to the board
+        fpga_ctrl_shadow.reset();
+        throw;
+    }
 }
 
-std::vector<SipmUsb::NrlListDataPoint>
+void HafxControl::select_nrl_bank(uint8_t buf_num) {
+    bool selected = fpga_ctrl_shadow &&
+        ((fpga_ctrl_shadow->registers[15] & 4) != 0) == (buf_num == 1);
+    if (!selected) {
+        swap_nrl_buffer(buf_num);
+        ++nrl_stats[buf_num].transitions;
+    }
+}
+
+SipmUsb::FpgaLmNrl1 const&
 HafxControl::read_nrl_buffer() {
     using namespace SipmUsb;
 
-    FpgaLmNrl1 nrl_buf;
-    driver->read(nrl_buf, MemoryType::ram);
-    return nrl_buf.decode();
+    driver->read(*nrl_buffer, MemoryType::ram);
+    return *nrl_buffer;
 }
 
 void HafxControl::poll_save_nrl_list() {
+    poll_save_nrl_list(read_status());
+}
+
+void HafxControl::poll_save_nrl_list(SipmUsb::FpgaResults const& status) {
     /*
      * Check if NRL list buffers 0 and 1 are full,
      * and read them out and save the contents
-     * if they are.
+     * if they are, oldest first.
      */
+    uint32_t time_after_read = time(NULL);
+    std::array<bool, 2> full{status.nrl_buffer_full(0), status.nrl_buffer_full(1)};
+    NrlPollResult result{
+        .banks_read = 0,
+        .events = 0,
+        .both_full = full[0] && full[1],
+    };
 
-    // Capture variables by reference into the lambda
-    auto save = [&](auto buf_num) {
-        using namespace SipmUsb;
-        
-        FpgaResults fpga_res_con;
-        driver->read(fpga_res_con, MemoryType::ram);
-        uint32_t time_after_read = time(NULL);
-        auto full = fpga_res_con.nrl_buffer_full(buf_num);
-        if (!full)
-            return;
-        log_debug(std::to_string(buf_num) + " is full");
-
-        this->swap_nrl_buffer(buf_num);
-        auto data = this->read_nrl_buffer();
-        // If there is no PPS in the data,
-        // we can't use it. So, discard it.
-        bool has_pps = false; 
-        for (const auto& d : data) {
-            has_pps = has_pps || d.was_pps;
-        }
-        if (!has_pps) {
-            log_info("there was no PPS in most recent NRL event list");
-            return;
-        }
+    if (result.both_full) {
+        ++nrl_stats[0].overruns;
+        ++nrl_stats[1].overruns;
+    }
+    else if (full[nrl_next_bank ^ 1]) {
+        // the board is a bank ahead (or behind) of us; go by what it says
+        nrl_next_bank ^= 1;
+        ++nrl_stats[nrl_next_bank].out_of_turn;
+        log_debug("NRL bank " + std::to_string(nrl_next_bank) + " filled out of turn");
+    }
 
-        std::string evts_save;
-        auto num_events = data.size();
-        evts_save = std::string{
-            reinterpret_cast<const char*>(data.data()),
-            data.size() * sizeof(decltype(data)::value_type)
-        };
-
-        // Put some metadata into strings to save
-        // Never gonna be more than 2048 events;
-        // could be fewer but unlikely
-        uint16_t len = static_cast<uint16_t>(num_events);
-        auto size_save = std::string{
-            reinterpret_cast<const char*>(&len),
-            sizeof(len)};
-        auto timestamp_save = std::string{
-            reinterpret_cast<const char*>(&time_after_read),
-            sizeof(time_after_read)};
-
-        auto &saver = this->nrl_data_saver;
-
-        // Save order:
-        //  - (2B) # of events recorded
-        //  - (N x M)B data; N is num events, M is event size
-        //  - (4B) timestamp immediately after readout
-        // save all at once so we don't get misaligned files
-        saver->add(size_save + evts_save + timestamp_save);
-    };
+    // Both full: the one due first filled first, so its events
+    // go out first
+    while (result.banks_read < 2 && full[nrl_next_bank]) {
+        read_save_nrl_bank(nrl_next_bank, time_after_read, result);
+        nrl_next_bank ^= 1;
+    }
 
-    // Save buffers 0, 1
-    save(0);
-    save(1);
+    // Point readout at the bank the board is filling now
+    if (result.banks_read > 0) {
+        select_nrl_bank(nrl_next_bank);
+    }
+    last_nrl_poll = result;
+}
+
+void HafxControl::read_save_nrl_bank(
+    uint8_t buf_num, uint32_t time_after_read, NrlPollResult& result)
+{
+    using namespace SipmUsb;
+    log_debug(std::to_string(buf_num) + " is full");
+
+    auto start = std::chrono::steady_clock::now();
+    this->select_nrl_bank(buf_num);
+    auto const& data = this->read_nrl_buffer();
+
+    auto& stats = nrl_stats[buf_num];
+    stats.last_read_latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    stats.max_read_latency = std::max(stats.max_read_latency, stats.last_read_latency);
+    ++stats.reads;
+    stats.events += data.num_events();
+
+    ++result.banks_read;
+    result.events += data.num_events();
+    if (data.count_clamped()) {
+        log_warning(
+            "NRL bank claims " + std::to_string(data.registers[0] & 0xfff) +
+            " slots; keeping the " + std::to_string(data.num_events()) + " events that fit");
+    }
+    auto flags = scan_nrl_flags(data.event_bytes());
+    this->nrl_flags += flags;
+    log_debug(
+        "NRL flags: " + std::to_string(flags.pps) + " pps, " +
+        std::to_string(flags.piled_up) + " piled up, " +
+        std::to_string(flags.sum_overflow) + " sum overflow, " +
+        std::to_string(flags.out_of_range) + " out of range, " +
+        std::to_string(flags.external_trigger) + " external trigger");
+
+    // If there is no PPS in the data,
+    // we can't use it. So, discard it.
+    if (flags.pps == 0) {
+        log_info("there was no PPS in most recent NRL event list");
+        return;
+    }
+
+    // Never gonna be more than 2048 events;
+    // could be fewer but unlikely
+    uint16_t len = static_cast<uint16_t>(data.num_events());
+
+    // Save order:
+    //  - (2B) # of events recorded
+    //  - (N x M)B data; N is num events, M is event size
+    //  - (4B) timestamp immediately after readout
+    // save all at once so we don't get misaligned files.
+    // The events go straight from the USB buffer to the socket.
+    this->nrl_data_saver->add_gather({
+        bytes_of(len),
+        data.event_bytes(),
+        bytes_of(time_after_read)
+    });
 }
 
 void HafxControl::update_settings(const DetectorMessages::HafxSettings& new_settings) {
@@ -320,6 +577,10 @@ void HafxControl::update_registers(SourceT const& source_regs) {
     for (size_t i = 0; i < con.registers.size(); ++i) {
         con.registers[i] = source_regs[i];
     }
+    if constexpr (std::is_same_v<ConT, SipmUsb::FpgaCtrl>) {
+        // read back from the board next time it's needed
+        fpga_ctrl_shadow.reset();
+    }
     driver->write(con, SipmUsb::MemoryType::nvram);
 }
 
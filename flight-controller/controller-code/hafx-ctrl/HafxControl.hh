@@ -1,11 +1,14 @@
 #pragma once
 
 #include <IoContainer.hh>
+#include <NrlScan.hh>
 #include <UsbManager.hh>
 
 #include <DetectorMessages.hh>
 
 #include <DetectorSupport.hh>
+#include <array>
+#include <chrono>
 #include <functional>
 #include <typeindex>
 #include <unordered_map>
@@ -13,6 +16,48 @@
 namespace Detector
 {
 
+// What one poll_save_nrl_list found
+struct NrlPollResult {
+    // banks read out, and the events in them
+    unsigned banks_read;
+    size_t events;
+    // both banks were full: the board may have had to drop events
+    bool both_full;
+};
+
+// Running totals for one NRL bank since list mode last started
+struct NrlBankStats {
+    uint64_t reads;
+    uint64_t events;
+    // polls that found this bank full along with the other one: the
+    // board had nowhere to put new events
+    uint64_t overruns;
+    // readout was pointed at this bank
+    uint64_t transitions;
+    // this bank filled when the other one was due: we'd lost track of
+    // which the board was filling
+    uint64_t out_of_turn;
+    // selecting and reading the bank, over USB
+    std::chrono::microseconds last_read_latency;
+    std::chrono::microseconds max_read_latency;
+};
+
+// What one poll_save_time_slice found
+struct TimeSlicePollResult {
+    // slices waiting on the board, out of FpgaResults::MAX_TIME_SLICES
+    uint16_t waiting;
+    // slices were dropped since the last poll
+    bool overflowed;
+};
+
+// Which struct time slices go out as
+enum class TimeSliceFormat {
+    // HafxNominalSpectrumStatus: everything widened to 32 bits
+    nominal,
+    // HafxCompactSpectrumStatus: 16 bits, as the board has them
+    compact,
+};
+
 class HafxControl {
 public:
     HafxControl(std::shared_ptr<SipmUsb::UsbManager> driver_, DetectorPorts ports);
@@ -25,8 +70,16 @@ public:
     void restart_trace();
     bool check_trace_done();
     void swap_nrl_buffer(uint8_t buf_num);
+
+    // One FpgaResults read says which NRL banks are full, how many
+    // time slices are waiting and whether a trace is done.  Read it
+    // once per poll cycle and hand it to everything the cycle does;
+    // without it, each of these reads its own.
+    SipmUsb::FpgaResults read_status();
     void poll_save_nrl_list();
+    void poll_save_nrl_list(SipmUsb::FpgaResults const& status);
     void poll_save_time_slice();
+    void poll_save_time_slice(SipmUsb::FpgaResults const& status);
 
     // debug, settings
     void update_settings(const DetectorMessages::HafxSettings& new_settings);
@@ -38,6 +91,30 @@ public:
 
     std::optional<time_t> data_time_anchor() const;
     void data_time_anchor(std::optional<time_t> new_anchor);
+
+    // Which detector this is, for the `ch` of each time slice
+    void science_channel(DetectorMessages::HafxChannel ch);
+    // Nominal unless asked.  Slices queued in the old format but not
+    // sent yet are dropped, so pick it before taking data.
+    void time_slice_format(TimeSliceFormat format);
+    TimeSliceFormat time_slice_format() const;
+
+    // Drop the USB connection and find the same board on the bus
+    // again.  The time anchor and any queued science data are kept.
+    // Throws DetectorException if the board can't be found.
+    void reconnect(size_t pipeline_depth);
+    std::optional<LibUsbCpp::UsbLocation> usb_location() const;
+
+    // Flags in the NRL banks read out since list mode last started;
+    // logged when list mode stops
+    SipmUsb::NrlFlagCounts nrl_flag_counts() const;
+    // What the last NRL poll found, once; nothing if there hasn't
+    // been one since last asked
+    std::optional<NrlPollResult> take_nrl_poll();
+    // Same for the last time slice poll
+    std::optional<TimeSlicePollResult> take_time_slice_poll();
+    // Readout totals for NRL banks 0 and 1 since list mode last started
+    std::array<NrlBankStats, 2> nrl_bank_stats() const;
 private:
     std::shared_ptr<SipmUsb::UsbManager> driver;
 
@@ -46,16 +123,54 @@ private:
     std::optional<time_t> science_time_anchor;
 
     using science_t = DetectorMessages::HafxNominalSpectrumStatus;
+    using compact_t = DetectorMessages::HafxCompactSpectrumStatus;
+    unsigned short science_port;
+    DetectorMessages::HafxChannel science_ch;
+    TimeSliceFormat slice_format;
+    // only the one for slice_format is made
     std::unique_ptr<QueuedDataSaver<science_t> > science_saver;
+    std::unique_ptr<QueuedDataSaver<compact_t> > compact_saver;
     std::unique_ptr<DataSaver> nrl_data_saver;
     std::unique_ptr<DataSaver> debug_saver;
-
-    DetectorMessages::HafxNominalSpectrumStatus
-    read_time_slice();
-
-    std::vector<SipmUsb::NrlListDataPoint>
+    // NRL banks are read into here and saved straight from it
+    std::unique_ptr<SipmUsb::FpgaLmNrl1> nrl_buffer;
+    SipmUsb::NrlFlagCounts nrl_flags;
+    std::optional<NrlPollResult> last_nrl_poll;
+
+    // The board fills NRL banks in turn, starting with 0, so the bank
+    // it filled first (the one to read first) alternates too.  Once a
+    // bank is read, readout is pointed at the other one, which the
+    // board is filling meanwhile; when it fills, it's one USB read away.
+    uint8_t nrl_next_bank;
+    std::array<NrlBankStats, 2> nrl_stats;
+    void read_save_nrl_bank(uint8_t buf_num, uint32_t time_after_read, NrlPollResult& result);
+    // swap_nrl_buffer, unless readout already points at `buf_num`
+    void select_nrl_bank(uint8_t buf_num);
+
+    // buffer number of the last time slice saved, to spot gaps
+    std::optional<uint16_t> last_buffer_number;
+    // flag the next slice saved: some before it were lost
+    // (compact slices only; see HafxCompactSpectrumStatus)
+    bool slices_lost;
+    std::optional<TimeSlicePollResult> last_time_slice_poll;
+    // Everything a poll finds waiting is read into here in one go
+    using TimeSliceBatch = std::array<SipmUsb::FpgaTimeSlice, SipmUsb::FpgaResults::MAX_TIME_SLICES>;
+    std::unique_ptr<TimeSliceBatch> time_slice_batch;
+
+    // What we last put in the FPGA control registers (RAM), so bank
+    // swaps don't have to read them back first.  Empty until first
+    // needed, and again whenever the board may have other values.
+    std::optional<SipmUsb::FpgaCtrl> fpga_ctrl_shadow;
+    SipmUsb::FpgaCtrl& fpga_ctrl();
+
+    SipmUsb::FpgaLmNrl1 const&
     read_nrl_buffer();
 
+    // Pack `raw` into `saver` and queue them; true if slices went
+    // missing in between
+    template<class SaverT>
+    bool save_time_slices(SaverT& saver, std::span<const SipmUsb::FpgaTimeSlice> raw);
+
     void save_settings(const DetectorMessages::HafxSettings& settings);
     void send_off_settings();
     DetectorMessages::HafxSettings
@@ -65,6 +180,24 @@ private:
     void update_registers(SourceT const& source_regs);
 };
 
+// Pack a decoded time slice for the science stream.  The first slice
+// of each second carries `anchor`, which then moves on a second.
+DetectorMessages::HafxNominalSpectrumStatus
+pack_time_slice(SipmUsb::DecodedTimeSlice const& decoded, time_t& anchor);
+// The same straight from the registers, into `out`; every field is
+// written, so it needn't be cleared first
+void pack_time_slice(
+    SipmUsb::FpgaTimeSlice const& raw, time_t& anchor,
+    DetectorMessages::HafxNominalSpectrumStatus& out);
+// And into the compact format (ch left 0)
+void pack_time_slice(
+    SipmUsb::FpgaTimeSlice const& raw, time_t& anchor,
+    DetectorMessages::HafxCompactSpectrumStatus& out);
+
+// Whether a time slice numbered `next` can come right after `last`,
+// with none lost in between
+bool time_slice_follows(uint16_t last, uint16_t next);
+
 // --
 // Template implementations
 
@@ -7,6 +7,7 @@
 #include <sys/socket.h>
 
 #include <HafxControl.hh>
+#include <SimulatedSipm3k.hh>
 #include <DetectorMessages.hh>
 
 constexpr unsigned short science_port = 30000;
@@ -26,6 +27,27 @@ std::unique_ptr<Detector::HafxControl> get_test_hafx_ctrl() {
     throw std::runtime_error{"no device connected"};
 }
 
+// The same on a simulated board (manual clock), with the board and
+// its USB manager to drive and inspect it
+struct SimulatedHafx {
+    std::shared_ptr<SipmUsb::SimulatedSipm3k> sim;
+    std::shared_ptr<SipmUsb::UsbManager> usb;
+    std::unique_ptr<Detector::HafxControl> ctrl;
+};
+
+SimulatedHafx get_simulated_hafx_ctrl(
+    double event_rate, unsigned short sci_port = science_port) {
+
+    auto sim = std::make_shared<SipmUsb::SimulatedSipm3k>(
+        SipmUsb::SimulatedSipm3kConfig{.event_rate = event_rate, .manual_clock = true});
+    auto usb = std::make_shared<SipmUsb::UsbManager>(sim);
+    auto ctrl = std::make_unique<Detector::HafxControl>(
+        usb,
+        Detector::DetectorPorts{sci_port, debug_port}
+    );
+    return {sim, usb, std::move(ctrl)};
+}
+
 
 TEST(HafxCtrl, CreationDeletion) {
     auto ctrl = get_test_hafx_ctrl();
@@ -184,6 +206,260 @@ TEST(HafxCtrl, FillBothBuffersAndRead) {
     
 }
 
+TEST(HafxCtrl, NrlSwapsStayInRam) {
+    // no hardware needed
+    using namespace std::chrono_literals;
+    auto [sim, usb, ctrl] = get_simulated_hafx_ctrl(3000);
+
+    ctrl->restart_list_mode();
+    // never more than a bank's worth between polls
+    for (int i = 0; i < 20; ++i) {
+        sim->advance(500ms);
+        ctrl->poll_save_nrl_list();
+
+        SipmUsb::FpgaResults res{};
+        usb->read(res, SipmUsb::MemoryType::ram);
+        EXPECT_FALSE(res.nrl_buffer_full(0));
+        EXPECT_FALSE(res.nrl_buffer_full(1));
+    }
+    EXPECT_EQ(sim->stats().nrl_events_dropped, 0u);
+    EXPECT_EQ(sim->stats().nvram_writes, 0u);
+    EXPECT_GT(ctrl->nrl_flag_counts().pps, 0u);
+}
+
+TEST(HafxCtrl, NrlPollReadsStatusOnce) {
+    using namespace std::chrono_literals;
+    auto [sim, usb, ctrl] = get_simulated_hafx_ctrl(3000);
+    ctrl->restart_list_mode();
+
+    // neither bank full: the status is all that's read
+    sim->advance(100ms);
+    auto before = sim->stats().bytes_in;
+    ctrl->poll_save_nrl_list();
+    EXPECT_EQ(sim->stats().bytes_in - before, sizeof(SipmUsb::FpgaResults));
+
+    // with a snapshot already in hand, nothing
+    sim->advance(100ms);
+    auto status = ctrl->read_status();
+    before = sim->stats().bytes_in;
+    ctrl->poll_save_nrl_list(status);
+    EXPECT_EQ(sim->stats().bytes_in, before);
+
+    // one full bank: status and the bank
+    sim->advance(600ms);
+    before = sim->stats().bytes_in;
+    ctrl->poll_save_nrl_list();
+    EXPECT_EQ(
+        sim->stats().bytes_in - before,
+        sizeof(SipmUsb::FpgaResults) + sizeof(SipmUsb::FpgaLmNrl1));
+}
+
+TEST(HafxCtrl, NrlBanksReadInTurn) {
+    using namespace std::chrono_literals;
+    auto [sim, usb, ctrl] = get_simulated_hafx_ctrl(3000);
+    ctrl->restart_list_mode();
+
+    auto selected_bank = [&]() {
+        SipmUsb::FpgaCtrl c{};
+        usb->read(c, SipmUsb::MemoryType::ram);
+        return (c.registers[15] & 4) ? 1 : 0;
+    };
+
+    // bank 0 fills first, and is ready to read
+    EXPECT_EQ(selected_bank(), 0);
+    sim->advance(700ms);
+    ctrl->poll_save_nrl_list();
+    auto stats = ctrl->nrl_bank_stats();
+    EXPECT_EQ(stats[0].reads, 1u);
+    EXPECT_EQ(stats[1].reads, 0u);
+    EXPECT_EQ(stats[0].transitions, 0u);
+    // then the one being filled
+    EXPECT_EQ(selected_bank(), 1);
+
+    // too slow: 1 fills, then 0, then events are dropped
+    sim->advance(1400ms);
+    ctrl->poll_save_nrl_list();
+    stats = ctrl->nrl_bank_stats();
+    EXPECT_GT(sim->stats().nrl_events_dropped, 0u);
+    EXPECT_EQ(stats[0].overruns, 1u);
+    EXPECT_EQ(stats[1].overruns, 1u);
+    EXPECT_EQ(stats[0].reads, 2u);
+    EXPECT_EQ(stats[1].reads, 1u);
+    EXPECT_EQ(stats[0].events + stats[1].events, 3u * SipmUsb::FpgaLmNrl1::MAX_EVENTS);
+    EXPECT_EQ(stats[0].out_of_turn + stats[1].out_of_turn, 0u);
+    // 1 went first, so 1 is next
+    EXPECT_EQ(selected_bank(), 1);
+
+    auto poll = ctrl->take_nrl_poll();
+    ASSERT_TRUE(poll);
+    EXPECT_EQ(poll->banks_read, 2u);
+    EXPECT_TRUE(poll->both_full);
+}
+
+TEST(HafxCtrl, TimeSlicePackFromRegisters) {
+    SipmUsb::FpgaTimeSlice raw;
+    for (size_t i = 0; i < raw.registers.size(); ++i) {
+        raw.registers[i] = static_cast<uint16_t>(1000 + 7 * i);
+    }
+
+    for (uint16_t bn : {0, 5, 33}) {
+        raw.registers[0] = bn;
+        time_t a1 = 100, a2 = 100;
+        auto expected = Detector::pack_time_slice(raw.decode(), a1);
+
+        // garbage first: every field gets written
+        DetectorMessages::HafxNominalSpectrumStatus packed;
+        std::memset(&packed, 0xa5, sizeof(packed));
+        Detector::pack_time_slice(raw, a2, packed);
+
+        EXPECT_EQ(std::memcmp(&expected, &packed, sizeof(packed)), 0) << "buffer number " << bn;
+        EXPECT_EQ(a1, a2);
+    }
+}
+
+TEST(HafxCtrl, CompactPackMatchesNominal) {
+    SipmUsb::FpgaTimeSlice raw;
+    for (size_t i = 0; i < raw.registers.size(); ++i) {
+        raw.registers[i] = static_cast<uint16_t>(60000 + 3 * i);
+    }
+
+    for (uint16_t bn : {0, 5, 33}) {
+        raw.registers[0] = bn;
+        time_t a1 = 100, a2 = 100;
+        DetectorMessages::HafxNominalSpectrumStatus nom;
+        Detector::pack_time_slice(raw, a1, nom);
+        DetectorMessages::HafxCompactSpectrumStatus comp;
+        std::memset(&comp, 0xa5, sizeof(comp));
+        Detector::pack_time_slice(raw, a2, comp);
+
+        EXPECT_EQ(comp.version, DetectorMessages::HafxCompactSpectrumStatus::VERSION_1);
+        EXPECT_EQ(comp.ch, 0);
+        EXPECT_EQ(comp.buffer_number, nom.buffer_number);
+        EXPECT_EQ(comp.num_evts, nom.num_evts);
+        EXPECT_EQ(comp.num_triggers, nom.num_triggers);
+        EXPECT_EQ(comp.dead_time, nom.dead_time);
+        EXPECT_EQ(comp.anode_current, nom.anode_current);
+        for (size_t i = 0; i < 123; ++i) {
+            EXPECT_EQ(comp.histogram[i], nom.histogram[i]) << "bin " << i;
+        }
+        EXPECT_EQ(comp.time_anchor, nom.time_anchor);
+        EXPECT_EQ(comp.missed_pps, nom.missed_pps);
+        EXPECT_FALSE(comp.slices_lost);
+        EXPECT_EQ(a1, a2);
+    }
+    // about half
+    EXPECT_LT(2 * sizeof(DetectorMessages::HafxCompactSpectrumStatus),
+        sizeof(DetectorMessages::HafxNominalSpectrumStatus) + 16);
+}
+
+TEST(HafxCtrl, TimeSliceGapsAcrossPps) {
+    using Detector::time_slice_follows;
+    EXPECT_TRUE(time_slice_follows(0, 1));
+    EXPECT_TRUE(time_slice_follows(30, 31));
+    EXPECT_TRUE(time_slice_follows(31, 0));
+    // PPS missed, then back
+    EXPECT_TRUE(time_slice_follows(31, 32));
+    EXPECT_TRUE(time_slice_follows(40, 0));
+
+    EXPECT_FALSE(time_slice_follows(3, 5));
+    EXPECT_FALSE(time_slice_follows(31, 1));
+    // the end of a second lost
+    EXPECT_FALSE(time_slice_follows(20, 0));
+    EXPECT_FALSE(time_slice_follows(0, 0));
+}
+
+TEST(HafxCtrl, CompactTimeSlicesSent) {
+    using namespace std::chrono_literals;
+    using compact_t = DetectorMessages::HafxCompactSpectrumStatus;
+    constexpr unsigned short PORT = 30500;
+
+    int sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    addr.sin_addr = in_addr{.s_addr = INADDR_ANY};
+    ASSERT_GE(sock_fd, 0);
+    ASSERT_EQ(bind(sock_fd, (sockaddr*)&addr, sizeof(addr)), 0);
+    fcntl(sock_fd, F_SETFL, fcntl(sock_fd, F_GETFL) | O_NONBLOCK);
+
+    auto [sim, usb, ctrl] = get_simulated_hafx_ctrl(100, PORT);
+    ctrl->science_channel(DetectorMessages::HafxChannel::M5);
+    ctrl->time_slice_format(Detector::TimeSliceFormat::compact);
+    ctrl->data_time_anchor(1000);
+    ctrl->restart_time_slice_or_histogram();
+
+    sim->advance(2s);
+    ctrl->poll_save_time_slice();
+
+    std::vector<unsigned char> buf(65536);
+    size_t datagrams = 0;
+    ssize_t received;
+    while ((received = recv(sock_fd, buf.data(), buf.size(), 0)) >= 0) {
+        ++datagrams;
+        ASSERT_EQ(static_cast<size_t>(received), 32 * sizeof(compact_t));
+        for (size_t i = 0; i < 32; ++i) {
+            compact_t slice;
+            std::memcpy(&slice, buf.data() + i * sizeof(slice), sizeof(slice));
+            EXPECT_EQ(slice.version, compact_t::VERSION_1);
+            EXPECT_EQ(slice.ch, static_cast<uint8_t>(DetectorMessages::HafxChannel::M5));
+            EXPECT_EQ(slice.buffer_number, i);
+            EXPECT_EQ(slice.time_anchor > 0, i == 0);
+        }
+    }
+    EXPECT_GE(datagrams, 1u);
+    close(sock_fd);
+}
+
+TEST(HafxCtrl, TimeSliceBatchReadsEverything) {
+    using namespace std::chrono_literals;
+    auto [sim, usb, ctrl] = get_simulated_hafx_ctrl(100);
+    ctrl->data_time_anchor(time(nullptr));
+    ctrl->restart_time_slice_or_histogram();
+
+    sim->advance(2s);
+    auto before = sim->stats().bytes_in;
+    auto status = ctrl->read_status();
+    auto waiting = status.num_avail_time_slices();
+    ASSERT_GT(waiting, 0);
+    ctrl->poll_save_time_slice(status);
+
+    EXPECT_EQ(sim->stats().bytes_in - before,
+        sizeof(SipmUsb::FpgaResults) + waiting * sizeof(SipmUsb::FpgaTimeSlice));
+    EXPECT_EQ(ctrl->read_status().num_avail_time_slices(), 0);
+}
+
+TEST(HafxCtrl, TimeSliceOverflowReported) {
+    using namespace std::chrono_literals;
+    auto [sim, usb, ctrl] = get_simulated_hafx_ctrl(100);
+    ctrl->data_time_anchor(time(nullptr));
+    ctrl->restart_time_slice_or_histogram();
+
+    // drained in time: nothing lost
+    sim->advance(2s);
+    ctrl->poll_save_time_slice();
+    auto poll = ctrl->take_time_slice_poll();
+    ASSERT_TRUE(poll);
+    EXPECT_FALSE(poll->overflowed);
+    EXPECT_LE(poll->waiting, 64);
+    EXPECT_FALSE(ctrl->take_time_slice_poll());
+
+    // a tick went missing: the FIFO filled up
+    sim->advance(5s);
+    ctrl->poll_save_time_slice();
+    poll = ctrl->take_time_slice_poll();
+    ASSERT_TRUE(poll);
+    EXPECT_TRUE(poll->overflowed);
+    EXPECT_EQ(poll->waiting, SipmUsb::FpgaResults::MAX_TIME_SLICES);
+    EXPECT_GT(sim->stats().slices_dropped, 0u);
+
+    // caught up again
+    sim->advance(1s);
+    ctrl->poll_save_time_slice();
+    poll = ctrl->take_time_slice_poll();
+    ASSERT_TRUE(poll);
+    EXPECT_FALSE(poll->overflowed);
+}
+
 int main(int argc, char *argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
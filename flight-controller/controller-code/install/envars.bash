@@ -4,6 +4,22 @@ export HAFX_M1_SERIAL="undefined"
 export HAFX_M5_SERIAL="undefined"
 export HAFX_X1_SERIAL="undefined"
 
+# USB chunk transfers kept in flight per HaFX board;
+# 0 means one blocking transfer at a time
+export HAFX_USB_PIPELINE_DEPTH=0
+
+# Milliseconds a poll waits on a detector before skipping it;
+# boards that keep missing it are quarantined and retried later
+export DET_POLL_BUDGET_MS=500
+
+# Shortest and longest wait between NRL list mode polls;
+# in between it follows the count rate
+export NRL_POLL_MIN_MS=5
+export NRL_POLL_MAX_MS=250
+
+# 1 sends HaFX time slices in the compact (16-bit) format
+export HAFX_COMPACT_SLICES=0
+
 
 # Detector ports - to be sourced in .bashrc
 # Ports in [base_port, base_port + 999] can be used
@@ -4,6 +4,32 @@
 
 namespace LibUsbCpp {
 
+EventThread::EventThread(libusb_context *ctx_)
+  : ctx(ctx_)
+  , running(true)
+  , thread([this]() {
+        while (running) {
+            // wake up now and then in case an interrupt is missed
+            timeval tv{0, 100'000};
+            int ret = libusb_handle_events_timeout_completed(ctx, &tv, nullptr);
+            if (ret < 0 && ret != LIBUSB_ERROR_INTERRUPTED) {
+                std::stringstream ss;
+                ss << "libusb event handling: " << libusb_strerror(ret);
+                log_error(ss.str());
+            }
+        }
+    })
+{
+    log_info("Started libusb event thread");
+}
+
+EventThread::~EventThread() {
+    running = false;
+    libusb_interrupt_event_handler(ctx);
+    thread.join();
+    log_info("Stopped libusb event thread");
+}
+
 Context::Context() {
     log_info("Constructing LibUsb::Context");
     int ret = libusb_init(&handle);
@@ -23,11 +49,20 @@ Context::Context() {
 }
 Context::~Context() {
     log_info("Destructing LibUsb::Context");
+    // must stop handling events before the context goes away
+    event_thread.reset();
     if (handle) {
         libusb_exit(handle);
     }
 }
 
+void Context::start_event_thread() {
+    std::lock_guard lock{event_mtx};
+    if (!event_thread) {
+        event_thread = std::make_unique<EventThread>(handle);
+    }
+}
+
 DeviceList::DeviceList(std::shared_ptr<Context> ctx_)
     : ctx(ctx_) {
     log_info("Constructing LibUsb::DeviceList");
@@ -90,6 +125,14 @@ DeviceHandle::~DeviceHandle() {
     }
 }
 
+UsbLocation DeviceHandle::location() const {
+    auto dev = libusb_get_device(handle);
+    return UsbLocation{
+        .bus = libusb_get_bus_number(dev),
+        .address = libusb_get_device_address(dev),
+    };
+}
+
 bool DeviceHandle::claim_interface(int interface) {
     int ret = libusb_claim_interface(handle, interface);
     if (ret == LIBUSB_ERROR_BUSY) {
@@ -105,4 +148,68 @@ bool DeviceHandle::claim_interface(int interface) {
     return true;
 }
 
+Hotplug::Hotplug(std::shared_ptr<Context> ctx_)
+  : ctx(ctx_) {
+    if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+        throw UsbException{"libusb hotplug is not supported here"};
+    }
+    // callbacks run from event handling
+    ctx->start_event_thread();
+}
+
+Hotplug::~Hotplug() {
+    for (auto h : registered) {
+        libusb_hotplug_deregister_callback(ctx->handle, h);
+    }
+}
+
+void Hotplug::watch(int vendor_id, int product_id, Callback callback) {
+    callbacks.push_back(std::make_unique<Callback>(std::move(callback)));
+
+    libusb_hotplug_callback_handle h;
+    int ret = libusb_hotplug_register_callback(
+        ctx->handle,
+        LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+        LIBUSB_HOTPLUG_NO_FLAGS,
+        vendor_id,
+        product_id,
+        LIBUSB_HOTPLUG_MATCH_ANY,
+        &Hotplug::on_event,
+        callbacks.back().get(),
+        &h
+    );
+    if (ret < 0) {
+        callbacks.pop_back();
+        std::stringstream ss;
+        ss << "couldn't register hotplug callback: " << libusb_strerror(ret);
+        throw UsbException(ss.str());
+    }
+    registered.push_back(h);
+}
+
+int LIBUSB_CALL Hotplug::on_event(
+    libusb_context*, libusb_device *device,
+    libusb_hotplug_event event, void *user_data
+) {
+    // the descriptor is cached by libusb, so this is fine on a
+    // device that has already gone
+    libusb_device_descriptor desc{};
+    (void) libusb_get_device_descriptor(device, &desc);
+
+    auto const& callback = *static_cast<Callback*>(user_data);
+    callback(HotplugEvent{
+        .kind = (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED)
+            ? HotplugEvent::Kind::arrived
+            : HotplugEvent::Kind::left,
+        .vendor_id = desc.idVendor,
+        .product_id = desc.idProduct,
+        .location = UsbLocation{
+            .bus = libusb_get_bus_number(device),
+            .address = libusb_get_device_address(device),
+        },
+    });
+    // stay registered
+    return 0;
+}
+
 } // namespace LibUsb
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include <libusb-1.0/libusb.h>
@@ -13,6 +18,19 @@ class UsbException : public std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
+// Runs libusb event handling on a background thread so asynchronous
+// transfers complete without their submitter having to poll for them.
+class EventThread {
+public:
+    explicit EventThread(libusb_context *ctx);
+    ~EventThread();
+
+private:
+    libusb_context *ctx;
+    std::atomic<bool> running;
+    std::thread thread;
+};
+
 // RAII wrapper classes around libusb pointers
 
 struct Context {
@@ -20,6 +38,14 @@ struct Context {
 
     Context();
     ~Context();
+
+    // Needed for asynchronous transfers.  Idempotent; the thread runs
+    // until the context is destroyed.
+    void start_event_thread();
+
+private:
+    std::mutex event_mtx;
+    std::unique_ptr<EventThread> event_thread;
 };
 
 struct DeviceList {
@@ -32,6 +58,15 @@ private:
     std::shared_ptr<Context> ctx;
 };
 
+// Where a device sits on the bus.  Unique while it stays plugged in;
+// a device that is unplugged and comes back gets a new address.
+struct UsbLocation {
+    uint8_t bus = 0;
+    uint8_t address = 0;
+
+    bool operator==(UsbLocation const&) const = default;
+};
+
 struct DeviceHandle {
     libusb_device_handle *handle = nullptr;
 
@@ -41,9 +76,61 @@ struct DeviceHandle {
 
     bool claim_interface(int interface);
 
+    std::shared_ptr<Context> context() const { return ctx; }
+    UsbLocation location() const;
+
 private:
     std::vector<int> claimed_interfaces;
     std::shared_ptr<Context> ctx;
 };
 
+struct HotplugEvent {
+    enum class Kind {
+        arrived,
+        left,
+    };
+    Kind kind;
+    uint16_t vendor_id;
+    uint16_t product_id;
+    UsbLocation location;
+};
+
+// Tells whoever is interested when USB devices are plugged in or
+// unplugged.  Hotplug is the real thing; tests can make their own.
+class HotplugSource {
+public:
+    using Callback = std::function<void(HotplugEvent const&)>;
+    static constexpr int MATCH_ANY = LIBUSB_HOTPLUG_MATCH_ANY;
+
+    virtual ~HotplugSource() = default;
+
+    // Call `callback` for every matching device that comes or goes,
+    // until this is destroyed.  It is called from another thread and
+    // must not block.
+    virtual void watch(int vendor_id, int product_id, Callback callback) = 0;
+};
+
+// libusb hotplug notifications for one context, delivered on its event
+// thread.  Throws UsbException if the platform doesn't support them.
+class Hotplug : public HotplugSource {
+public:
+    explicit Hotplug(std::shared_ptr<Context> ctx);
+    ~Hotplug() override;
+
+    Hotplug(Hotplug const&) =delete;
+    Hotplug& operator=(Hotplug const&) =delete;
+
+    void watch(int vendor_id, int product_id, Callback callback) override;
+
+private:
+    std::shared_ptr<Context> ctx;
+    std::vector<libusb_hotplug_callback_handle> registered;
+    // handed to libusb as user data, so they must not move
+    std::vector<std::unique_ptr<Callback>> callbacks;
+
+    static int LIBUSB_CALL on_event(
+        libusb_context *ctx, libusb_device *device,
+        libusb_hotplug_event event, void *user_data);
+};
+
 } // namespace LibUsb
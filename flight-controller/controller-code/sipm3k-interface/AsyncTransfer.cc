@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <sstream>
+
+#include "AsyncTransfer.hh"
+#include "LibUsbCpp.hh"
+#include "logging.hh"
+
+namespace SipmUsb {
+
+AsyncChunkTransfer::AsyncChunkTransfer(libusb_device_handle *handle_, size_t depth) :
+    handle(handle_),
+    transfers(),
+    mtx(),
+    done_cv(),
+    idle(),
+    in_flight(0),
+    error(0)
+{
+    depth = std::max<size_t>(depth, 1);
+    transfers.reserve(depth);
+    idle.reserve(depth);
+    for (size_t i = 0; i < depth; ++i) {
+        auto *xfer = libusb_alloc_transfer(0);
+        if (xfer == nullptr) {
+            for (auto *t : transfers) {
+                libusb_free_transfer(t);
+            }
+            throw LibUsbCpp::UsbException("couldn't allocate libusb transfer");
+        }
+        transfers.push_back(xfer);
+        idle.push_back(xfer);
+    }
+}
+
+AsyncChunkTransfer::~AsyncChunkTransfer() {
+    // run() never returns with anything in flight
+    for (auto *xfer : transfers) {
+        libusb_free_transfer(xfer);
+    }
+}
+
+int AsyncChunkTransfer::run(
+    unsigned char endpoint,
+    unsigned char *buffer,
+    int num_bytes,
+    int chunk_size,
+    unsigned int timeout_ms
+) {
+    const int num_chunks = (num_bytes + chunk_size - 1) / chunk_size;
+    int next_chunk = 0;
+    bool cancelled = false;
+
+    std::unique_lock lock{mtx};
+    error = 0;
+    while (true) {
+        // keep the pipeline full
+        while (error == 0 && next_chunk < num_chunks && !idle.empty()) {
+            auto *xfer = idle.back();
+            idle.pop_back();
+
+            int offset = next_chunk * chunk_size;
+            int length = std::min(chunk_size, num_bytes - offset);
+            libusb_fill_bulk_transfer(
+                xfer, handle, endpoint, buffer + offset, length,
+                &AsyncChunkTransfer::on_complete, this, timeout_ms);
+
+            // completions only ever run on the event thread, which
+            // needs `mtx` first, so submitting under the lock is safe
+            int ret = libusb_submit_transfer(xfer);
+            if (ret < 0) {
+                idle.push_back(xfer);
+                error = ret;
+                break;
+            }
+            ++in_flight;
+            ++next_chunk;
+        }
+
+        if (in_flight == 0 && (error != 0 || next_chunk == num_chunks)) {
+            return error;
+        }
+
+        if (error != 0 && !cancelled) {
+            // give up on the rest; later chunks would land in the wrong place
+            cancelled = true;
+            for (auto *xfer : transfers) {
+                if (std::find(idle.begin(), idle.end(), xfer) == idle.end()) {
+                    libusb_cancel_transfer(xfer);
+                }
+            }
+        }
+
+        done_cv.wait(lock);
+    }
+}
+
+void LIBUSB_CALL AsyncChunkTransfer::on_complete(libusb_transfer *xfer) {
+    auto *self = static_cast<AsyncChunkTransfer*>(xfer->user_data);
+    std::lock_guard lock{self->mtx};
+
+    if (xfer->status != LIBUSB_TRANSFER_COMPLETED) {
+        if (self->error == 0) {
+            self->error = status_to_error(xfer->status);
+        }
+    }
+    else if (xfer->actual_length != xfer->length) {
+        // same as the synchronous path: worth knowing, not fatal
+        std::stringstream ss;
+        ss << "didn't read/write appropriate chunk size: "
+           << xfer->actual_length << " vs " << xfer->length;
+        log_error(ss.str());
+    }
+
+    --self->in_flight;
+    self->idle.push_back(xfer);
+    self->done_cv.notify_one();
+}
+
+int AsyncChunkTransfer::status_to_error(libusb_transfer_status status) {
+    switch (status) {
+        case LIBUSB_TRANSFER_COMPLETED: return LIBUSB_SUCCESS;
+        case LIBUSB_TRANSFER_TIMED_OUT: return LIBUSB_ERROR_TIMEOUT;
+        case LIBUSB_TRANSFER_STALL: return LIBUSB_ERROR_PIPE;
+        case LIBUSB_TRANSFER_NO_DEVICE: return LIBUSB_ERROR_NO_DEVICE;
+        case LIBUSB_TRANSFER_OVERFLOW: return LIBUSB_ERROR_OVERFLOW;
+        case LIBUSB_TRANSFER_CANCELLED: return LIBUSB_ERROR_INTERRUPTED;
+        default: return LIBUSB_ERROR_IO;
+    }
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <libusb-1.0/libusb.h>
+
+namespace SipmUsb {
+
+/*
+ * Moves a buffer over one bulk endpoint in fixed-size chunks, keeping
+ * up to `depth` chunk transfers submitted at once.  The ARM can still
+ * only take one 256-byte chunk at a time, but with the next chunks
+ * already queued on the host the device doesn't sit idle for a whole
+ * submit/complete round trip between them.
+ *
+ * Chunks are read or written in place, and the libusb_transfer objects
+ * are allocated once up front and reused for every call.
+ *
+ * Completions are delivered by the context's event thread
+ * (LibUsbCpp::Context::start_event_thread).  One transfer at a time:
+ * don't call run() concurrently.
+ */
+class AsyncChunkTransfer {
+public:
+    AsyncChunkTransfer(libusb_device_handle *handle, size_t depth);
+    ~AsyncChunkTransfer();
+
+    AsyncChunkTransfer(AsyncChunkTransfer const&) =delete;
+    AsyncChunkTransfer& operator=(AsyncChunkTransfer const&) =delete;
+
+    // 0 on success or a libusb_error, same as libusb_bulk_transfer.
+    // Returns only once nothing is in flight any more.
+    int run(
+        unsigned char endpoint,
+        unsigned char *buffer,
+        int num_bytes,
+        int chunk_size,
+        unsigned int timeout_ms
+    );
+
+    size_t depth() const { return transfers.size(); }
+
+private:
+    libusb_device_handle *handle;
+    std::vector<libusb_transfer*> transfers;
+
+    // guarded by mtx; the event thread updates them on completion
+    std::mutex mtx;
+    std::condition_variable done_cv;
+    std::vector<libusb_transfer*> idle;
+    size_t in_flight;
+    int error;
+
+    static void LIBUSB_CALL on_complete(libusb_transfer *xfer);
+    static int status_to_error(libusb_transfer_status status);
+};
+
+}
@@ -72,26 +72,47 @@ namespace SipmUsb
     }
 
     std::vector<NrlListDataPoint> FpgaLmNrl1::decode() const {
-        // size per event: 6 (x2 bytes)
-        constexpr size_t EVT_SIZE = 6;
-        uint16_t num_evts = registers[0] & 0xfff;
-
-        NrlListDataPoint cur_data;
-        std::vector<NrlListDataPoint> ret;
-        // Skip the first event because it's special
-        for (size_t i = EVT_SIZE; i < (EVT_SIZE * num_evts); i += EVT_SIZE) {
-            std::memset(&cur_data, 0, sizeof(cur_data));
-            // Memcpy the buffer into our bit field struct
-            std::memcpy(
-                &cur_data,
-                registers.data() + i,
-                sizeof(cur_data)
-            );
-            // We memset the cur_data at each iteration
-            // so moving it is fine to do
-            ret.push_back(std::move(cur_data));
+        std::vector<NrlListDataPoint> ret(num_events());
+        decode_into(ret);
+        return ret;
+    }
+
+    NrlDecoded FpgaLmNrl1::decode_into(std::span<NrlListDataPoint> out) const {
+        auto evts = event_bytes();
+        size_t n = std::min(out.size(), num_events());
+        if (n > 0) {
+            std::memcpy(out.data(), evts.data(), n * sizeof(NrlListDataPoint));
         }
+        return {.events = out.first(n), .count_clamped = count_clamped()};
+    }
 
-        return ret;
+    size_t FpgaLmNrl1::num_events() const {
+        size_t num_slots = registers[0] & 0xfff;
+        return std::min(num_slots > 0 ? num_slots - 1 : 0, MAX_EVENTS);
+    }
+
+    bool FpgaLmNrl1::count_clamped() const {
+        return (registers[0] & 0xfffu) > MAX_EVENTS + 1;
+    }
+
+    std::span<const unsigned char> FpgaLmNrl1::event_bytes() const {
+        auto start = reinterpret_cast<const unsigned char*>(registers.data());
+        // skip the first slot
+        return {start + sizeof(NrlListDataPoint), num_events() * sizeof(NrlListDataPoint)};
+    }
+
+    bool FpgaLmNrl1::has_pps() const {
+        // was_pps is bit 55 of the 64 bits after psd and energy
+        constexpr size_t FLAGS_OFFSET = 2 * sizeof(uint16_t);
+        constexpr uint64_t PPS_BIT = uint64_t{1} << 55;
+        auto evts = event_bytes();
+        for (size_t i = 0; i < evts.size(); i += sizeof(NrlListDataPoint)) {
+            uint64_t word;
+            std::memcpy(&word, evts.data() + i + FLAGS_OFFSET, sizeof(word));
+            if (word & PPS_BIT) {
+                return true;
+            }
+        }
+        return false;
     }
 }
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <span>
 #include <vector>
 #include <utility>
 #include <cstdint>
@@ -85,6 +86,10 @@ namespace SipmUsb
     using FpgaStatistics = FpgaIoContainer<uint32_t, 16, 1>;
 
     struct FpgaResults : public FpgaIoContainer<uint16_t, 16, 2> {
+        // The count of waiting time slices is 7 bits, and so is the
+        // board's FIFO: once it's full, new slices are dropped
+        static constexpr uint16_t MAX_TIME_SLICES = 0x7f;
+
         bool trace_done() const;
         uint16_t num_avail_time_slices() const;
         bool nrl_buffer_full(uint8_t buf_num) const;
@@ -156,9 +161,44 @@ namespace SipmUsb
         // padding bits we can ignore
         uint64_t padding          : 8;
     };
+    struct NrlDecoded {
+        // view into the storage given to decode_into
+        std::span<const NrlListDataPoint> events;
+        // the header claimed more events than a bank holds; what
+        // does fit was decoded
+        bool count_clamped;
+    };
+
+    /*
+     * One NRL bank: 2048 slots of 12 bytes.  Slot 0 isn't an event:
+     * the board writes the slot count in the low 12 bits of its first
+     * word (counting slot 0 itself), so the events are slots
+     * 1..count-1.  Twelve bits can say up to 4095 slots, more than
+     * the bank has; anything past the end is never read.
+     */
     struct FpgaLmNrl1 : public FpgaIoContainer<uint16_t, 6*2048ULL, 5> {
+        static constexpr size_t MAX_EVENTS = 2047;
+
+        // Allocates; decode_into doesn't
         std::vector<NrlListDataPoint> decode() const;
+        // Decode into `out`, as many events as fit in it
+        NrlDecoded decode_into(std::span<NrlListDataPoint> out) const;
+
+        // Events in the buffer (the first slot isn't one); never more
+        // than fit
+        size_t num_events() const;
+        // The header's count can't be right
+        bool count_clamped() const;
+        // The events as they sit in the registers, same layout as
+        // NrlListDataPoint, so they can be saved without decoding
+        std::span<const unsigned char> event_bytes() const;
+        bool has_pps() const;
     };
+    static_assert(
+        (FpgaLmNrl1::MAX_EVENTS + 1) * sizeof(NrlListDataPoint) ==
+        sizeof(FpgaLmNrl1::Registers));
+    // Enough room for any bank, to decode into again and again
+    using NrlEventArray = std::array<NrlListDataPoint, FpgaLmNrl1::MAX_EVENTS>;
 
     using FpgaMap = FpgaIoContainer<uint16_t, 2048ULL, 8>;
 }
@@ -0,0 +1,170 @@
+#include "NrlScan.hh"
+#include "IoContainer.hh"
+
+#include <bit>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace SipmUsb {
+
+NrlFlagCounts& NrlFlagCounts::operator+=(NrlFlagCounts const& other) {
+    pps += other.pps;
+    external_trigger += other.external_trigger;
+    piled_up += other.piled_up;
+    sum_overflow += other.sum_overflow;
+    out_of_range += other.out_of_range;
+    return *this;
+}
+
+namespace {
+constexpr size_t EVT_SIZE = sizeof(NrlListDataPoint);
+static_assert(EVT_SIZE == 12);
+
+// The 64 bits after psd and energy hold the wall clock in bits 0-50
+// and the flags in 51-55, so the flags are bits 3-7 of byte 10
+constexpr size_t FLAGS_BYTE = 10;
+constexpr unsigned EXT_TRIG_BIT = 3;
+constexpr unsigned PILED_UP_BIT = 4;
+constexpr unsigned SUM_OVERFLOW_BIT = 5;
+constexpr unsigned OUT_OF_RANGE_BIT = 6;
+constexpr unsigned PPS_BIT = 7;
+
+class PpsIndices {
+public:
+    explicit PpsIndices(std::span<uint16_t> dest) : dest{dest}, num{0} { }
+    void add(size_t evt_idx) {
+        if (num < dest.size()) {
+            dest[num++] = static_cast<uint16_t>(evt_idx);
+        }
+    }
+private:
+    std::span<uint16_t> dest;
+    size_t num;
+};
+
+void scan_scalar(
+    unsigned char const* evts, size_t begin, size_t end,
+    NrlFlagCounts& counts, PpsIndices& pps_out)
+{
+    for (size_t i = begin; i < end; ++i) {
+        unsigned flags = evts[i * EVT_SIZE + FLAGS_BYTE];
+        counts.external_trigger += (flags >> EXT_TRIG_BIT) & 1;
+        counts.piled_up += (flags >> PILED_UP_BIT) & 1;
+        counts.sum_overflow += (flags >> SUM_OVERFLOW_BIT) & 1;
+        counts.out_of_range += (flags >> OUT_OF_RANGE_BIT) & 1;
+        if ((flags >> PPS_BIT) & 1) {
+            ++counts.pps;
+            pps_out.add(i);
+        }
+    }
+}
+
+#if defined(__AVX2__)
+// 8 events at a time; returns how many were scanned
+size_t scan_vector(
+    unsigned char const* evts, size_t num_evts,
+    NrlFlagCounts& counts, PpsIndices& pps_out)
+{
+    // Bytes 8-11 of each event, as the third 32-bit word; byte 10
+    // becomes bits 16-23 of the lane
+    const __m256i word_idx = _mm256_setr_epi32(2, 5, 8, 11, 14, 17, 20, 23);
+    // sign bit of each lane, as an 8-bit mask
+    auto lanes = [](__m256i v) {
+        return static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(v)));
+    };
+
+    size_t i = 0;
+    for (; i + 8 <= num_evts; i += 8) {
+        auto base = reinterpret_cast<int const*>(evts + i * EVT_SIZE);
+        __m256i words = _mm256_i32gather_epi32(base, word_idx, 4);
+        // PPS bit up to the sign bit; the other flags follow it down
+        __m256i flags = _mm256_slli_epi32(words, 8);
+
+        unsigned pps = lanes(flags);
+        counts.out_of_range += std::popcount(lanes(_mm256_slli_epi32(flags, 1)));
+        counts.sum_overflow += std::popcount(lanes(_mm256_slli_epi32(flags, 2)));
+        counts.piled_up += std::popcount(lanes(_mm256_slli_epi32(flags, 3)));
+        counts.external_trigger += std::popcount(lanes(_mm256_slli_epi32(flags, 4)));
+        counts.pps += std::popcount(pps);
+        for (; pps != 0; pps &= pps - 1) {
+            pps_out.add(i + std::countr_zero(pps));
+        }
+    }
+    return i;
+}
+#elif defined(__ARM_NEON)
+// 4 events at a time; returns how many were scanned
+size_t scan_vector(
+    unsigned char const* evts, size_t num_evts,
+    NrlFlagCounts& counts, PpsIndices& pps_out)
+{
+    const uint32x4_t one = vdupq_n_u32(1);
+    uint32x4_t ext = vdupq_n_u32(0);
+    uint32x4_t piled = vdupq_n_u32(0);
+    uint32x4_t sum_ovf = vdupq_n_u32(0);
+    uint32x4_t oor = vdupq_n_u32(0);
+    uint32x4_t pps_total = vdupq_n_u32(0);
+
+    size_t i = 0;
+    for (; i + 4 <= num_evts; i += 4) {
+        // Three 32-bit words per event, split out so val[2] is bytes
+        // 8-11 of each; byte 10 is bits 16-23 of the lane
+        uint32x4x3_t words = vld3q_u32(reinterpret_cast<uint32_t const*>(evts + i * EVT_SIZE));
+        uint32x4_t flags = vshrq_n_u32(words.val[2], 16 + EXT_TRIG_BIT);
+
+        ext = vaddq_u32(ext, vandq_u32(flags, one));
+        piled = vaddq_u32(piled, vandq_u32(vshrq_n_u32(flags, 1), one));
+        sum_ovf = vaddq_u32(sum_ovf, vandq_u32(vshrq_n_u32(flags, 2), one));
+        oor = vaddq_u32(oor, vandq_u32(vshrq_n_u32(flags, 3), one));
+        uint32x4_t pps = vandq_u32(vshrq_n_u32(flags, 4), one);
+        pps_total = vaddq_u32(pps_total, pps);
+
+        // PPS events are rare (one a second), so find them the slow way
+        uint64x2_t any = vreinterpretq_u64_u32(pps);
+        if ((vgetq_lane_u64(any, 0) | vgetq_lane_u64(any, 1)) != 0) {
+            for (size_t j = i; j < i + 4; ++j) {
+                if ((evts[j * EVT_SIZE + FLAGS_BYTE] >> PPS_BIT) & 1) {
+                    pps_out.add(j);
+                }
+            }
+        }
+    }
+
+    auto total = [](uint32x4_t v) {
+        uint32_t lanes[4];
+        vst1q_u32(lanes, v);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    };
+    counts.external_trigger += total(ext);
+    counts.piled_up += total(piled);
+    counts.sum_overflow += total(sum_ovf);
+    counts.out_of_range += total(oor);
+    counts.pps += total(pps_total);
+    return i;
+}
+#else
+size_t scan_vector(unsigned char const*, size_t, NrlFlagCounts&, PpsIndices&) {
+    return 0;
+}
+#endif
+}
+
+NrlFlagCounts scan_nrl_flags(
+    std::span<const unsigned char> event_bytes,
+    std::span<uint16_t> pps_indices)
+{
+    NrlFlagCounts counts{};
+    PpsIndices pps_out{pps_indices};
+    size_t num_evts = event_bytes.size() / EVT_SIZE;
+
+    // whatever the vector kernel leaves over, one at a time
+    size_t done = scan_vector(event_bytes.data(), num_evts, counts, pps_out);
+    scan_scalar(event_bytes.data(), done, num_evts, counts, pps_out);
+    return counts;
+}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+namespace SipmUsb {
+
+// How many events in an NRL bank carry each flag
+struct NrlFlagCounts {
+    uint32_t pps;
+    uint32_t external_trigger;
+    uint32_t piled_up;
+    uint32_t sum_overflow;
+    uint32_t out_of_range;
+
+    NrlFlagCounts& operator+=(NrlFlagCounts const& other);
+    bool operator==(NrlFlagCounts const&) const = default;
+};
+
+/*
+ * One pass over NRL events laid out as NrlListDataPoint (what
+ * FpgaLmNrl1::event_bytes() gives back), without decoding them.
+ *
+ * Counts the flags, and writes the index of each PPS event into
+ * `pps_indices` until it's full; the `pps` count is always the total.
+ *
+ * The flags all sit in byte 10 of an event, so this is vectorized:
+ * AVX2 or NEON when the compiler targets them, plain C++ otherwise.
+ */
+NrlFlagCounts scan_nrl_flags(
+    std::span<const unsigned char> event_bytes,
+    std::span<uint16_t> pps_indices = {});
+
+}
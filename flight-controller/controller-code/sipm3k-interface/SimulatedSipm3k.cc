@@ -0,0 +1,500 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#include "SimulatedSipm3k.hh"
+
+namespace SipmUsb
+{
+
+namespace {
+// same as the boards; see UsbManager
+constexpr int CMD_OUT_EP = 0x01;
+constexpr int DATA_OUT_EP = 0x02;
+constexpr int DATA_IN_EP = 0x82;
+constexpr uint32_t SHORT_WRITE_FLAG = 0x800;
+// memory type in the command header, bits 12-15 (MemoryType)
+constexpr uint32_t MEM_NVRAM = 1;
+constexpr int CHUNK_SZ = 256;
+
+// FpgaCtrl register 15, bit 2: which NRL bank is read out
+constexpr size_t NRL_BANK_SELECT_REG = 15;
+constexpr uint16_t NRL_BANK_SELECT_BIT = 4;
+
+// FpgaAction bits
+constexpr uint16_t CLEAR_ALL = 0b1111;
+constexpr uint16_t MODE_HISTOGRAM = 0b0001;
+constexpr uint16_t MODE_TRACE = 0b0010;
+constexpr uint16_t MODE_LIST = 0b0100;
+
+constexpr auto TRACE_TIME = std::chrono::milliseconds{10};
+
+double seconds(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+}
+
+// poisson_distribution wants a positive mean
+uint32_t poisson(std::mt19937& rng, double mean) {
+    return (mean > 0) ? std::poisson_distribution<uint32_t>{mean}(rng) : 0;
+}
+
+template<typename ConT>
+void copy_out(ConT const& con, unsigned char* data) {
+    std::memcpy(data, &con, sizeof(con));
+}
+}
+
+SimulatedSipm3k::SimulatedSipm3k(SimulatedSipm3kConfig config_) :
+    mtx(),
+    config(std::move(config_)),
+    rng(config.seed),
+    now(clock::duration::zero()),
+    last_wall(clock::now()),
+    histogram_mode(false),
+    list_mode(false),
+    trace_mode(false),
+    acquisition_start(),
+    trace_start(),
+    slices_made(0),
+    slice_fifo(),
+    histogram{},
+    nrl_banks(),
+    filling_bank(0),
+    next_pps_second(1),
+    list_events(),
+    live_ticks(0),
+    counts(0),
+    dead_ticks(0),
+    stored(),
+    pending_read(),
+    pending_write(),
+    error_to_inject(0),
+    errors_left(0),
+    counters()
+{
+    ArmVersion version{};
+    for (size_t i = 0; i < 16 && 2*i + 1 < config.serial.size(); ++i) {
+        version.registers[8 + i] = static_cast<uint8_t>(
+            std::stoul(config.serial.substr(2*i, 2), nullptr, 16));
+    }
+    auto& v = stored[{false, ArmVersion::mca_flags.command_ident}];
+    v.resize(sizeof(version));
+    std::memcpy(v.data(), &version, sizeof(version));
+}
+
+void SimulatedSipm3k::advance(clock::duration dt) {
+    std::lock_guard lock{mtx};
+    acquire(now, now + dt);
+    now += dt;
+}
+
+void SimulatedSipm3k::inject_error(int libusb_error, unsigned count) {
+    std::lock_guard lock{mtx};
+    error_to_inject = libusb_error;
+    errors_left = count;
+}
+
+SimulatedSipm3k::Stats SimulatedSipm3k::stats() const {
+    std::lock_guard lock{mtx};
+    return counters;
+}
+
+int SimulatedSipm3k::transfer(
+    int endpoint, unsigned char* buffer, int num_bytes, unsigned int)
+{
+    std::lock_guard lock{mtx};
+    if (errors_left > 0) {
+        --errors_left;
+        return error_to_inject;
+    }
+    catch_up();
+
+    if (config.chunk_latency.count() > 0) {
+        auto chunks = (num_bytes + CHUNK_SZ - 1) / CHUNK_SZ;
+        std::this_thread::sleep_for(chunks * config.chunk_latency);
+    }
+
+    switch (endpoint) {
+        case CMD_OUT_EP:
+            return handle_command(buffer, num_bytes);
+
+        case DATA_OUT_EP: {
+            if (!pending_write) {
+                return LIBUSB_ERROR_PIPE;
+            }
+            auto cmd = *std::exchange(pending_write, std::nullopt);
+            if (static_cast<uint32_t>(num_bytes) != cmd.nbytes) {
+                return LIBUSB_ERROR_OVERFLOW;
+            }
+            apply_write(cmd, buffer, num_bytes);
+            counters.bytes_out += num_bytes;
+            return 0;
+        }
+
+        case DATA_IN_EP: {
+            // the board has nothing to say
+            if (!pending_read) {
+                return LIBUSB_ERROR_TIMEOUT;
+            }
+            auto cmd = *std::exchange(pending_read, std::nullopt);
+            if (static_cast<uint32_t>(num_bytes) != cmd.nbytes) {
+                return LIBUSB_ERROR_OVERFLOW;
+            }
+            serve_read(cmd, buffer);
+            counters.bytes_in += num_bytes;
+            return 0;
+        }
+    }
+    return LIBUSB_ERROR_INVALID_PARAM;
+}
+
+int SimulatedSipm3k::handle_command(unsigned char const* buffer, int num_bytes) {
+    uint32_t header = 0;
+    if (num_bytes < static_cast<int>(sizeof(header))) {
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+    std::memcpy(&header, buffer, sizeof(header));
+    counters.bytes_out += num_bytes;
+
+    uint8_t type = header & 0xf;
+    Command cmd{
+        .fpga = (type == FPGA_READ_TYPE || type == FPGA_WRITE_TYPE),
+        .nvram = ((header >> 12) & 0xf) == MEM_NVRAM,
+        .ident = static_cast<uint8_t>((header >> 4) & 0x7f),
+        .nbytes = header >> 16,
+    };
+    pending_read.reset();
+    pending_write.reset();
+
+    if (type == FPGA_READ_TYPE || type == ARM_READ_TYPE) {
+        pending_read = cmd;
+    }
+    else if (type == FPGA_WRITE_TYPE || type == ARM_WRITE_TYPE) {
+        if (header & SHORT_WRITE_FLAG) {
+            // data came along in the command buffer
+            auto size = std::min<size_t>(
+                register_bytes(cmd.fpga, cmd.ident), num_bytes - sizeof(header));
+            apply_write(cmd, buffer + sizeof(header), size);
+        }
+        else {
+            pending_write = cmd;
+        }
+    }
+    else {
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+    return 0;
+}
+
+size_t SimulatedSipm3k::register_bytes(bool fpga, uint8_t ident) const {
+    if (!fpga) {
+        switch (ident) {
+            case 0: return sizeof(ArmVersion);
+            case 1: return sizeof(ArmStatus);
+            case 2: return sizeof(ArmCtrl);
+            case 3: return sizeof(ArmCal);
+        }
+        return 0;
+    }
+    switch (ident) {
+        case 0: return sizeof(FpgaCtrl);
+        case 1: return sizeof(FpgaStatistics);
+        case 2: return sizeof(FpgaResults);
+        case 7: return sizeof(FpgaAction);
+    }
+    // the rest are never short
+    return 0;
+}
+
+void SimulatedSipm3k::apply_write(Command const& cmd, unsigned char const* data, size_t size) {
+    if (cmd.nvram) {
+        ++counters.nvram_writes;
+    }
+    if (cmd.fpga && cmd.ident == FpgaAction::mca_flags.command_ident) {
+        FpgaAction action{};
+        std::memcpy(&action, data, std::min(size, sizeof(action)));
+        auto const& regs = action.registers;
+        if ((regs[0] & CLEAR_ALL) == CLEAR_ALL) {
+            clear_acquisition();
+        }
+        histogram_mode = regs[2] & MODE_HISTOGRAM;
+        trace_mode = regs[2] & MODE_TRACE;
+        list_mode = regs[2] & MODE_LIST;
+        if (trace_mode) {
+            trace_start = now;
+        }
+        return;
+    }
+
+    // generated on the fly; writes do nothing
+    bool generated = cmd.fpga
+        ? (cmd.ident >= 1 && cmd.ident <= 5)
+        : (cmd.ident <= 1);
+    if (generated) {
+        return;
+    }
+    auto& regs = stored[{cmd.fpga, cmd.ident}];
+    regs.assign(data, data + size);
+}
+
+void SimulatedSipm3k::clear_acquisition() {
+    acquisition_start = now;
+    slices_made = 0;
+    slice_fifo.clear();
+    histogram.fill(0);
+    for (auto& bank : nrl_banks) {
+        bank.events.clear();
+        bank.full = false;
+    }
+    filling_bank = 0;
+    next_pps_second = 1;
+    list_events.clear();
+    live_ticks = 0;
+    counts = 0;
+    dead_ticks = 0;
+}
+
+uint16_t SimulatedSipm3k::results_register() const {
+    uint16_t avail = static_cast<uint16_t>(std::min(slice_fifo.size(), MAX_SLICES));
+    bool trace_done = trace_mode && (now - trace_start) >= TRACE_TIME;
+    return static_cast<uint16_t>(
+        (avail << 9)
+        | (nrl_banks[1].full ? 8 : 0)
+        | (trace_done ? 4 : 0)
+        | (nrl_banks[0].full ? 2 : 0)
+    );
+}
+
+void SimulatedSipm3k::serve_read(Command const& cmd, unsigned char* data) {
+    if (!cmd.fpga && cmd.ident == 1) {
+        ArmStatus status{};
+        // volts, volts, -, deg C, deg C
+        status.registers = {28.5f, 28.5f, 0.f, 31.f, 22.f, 0.f, 0.f};
+        return copy_out(status, data);
+    }
+
+    if (cmd.fpga) switch (cmd.ident) {
+        case 1: {
+            FpgaStatistics st{};
+            st.registers[0] = static_cast<uint32_t>(live_ticks);
+            st.registers[1] = counts;
+            st.registers[3] = dead_ticks;
+            return copy_out(st, data);
+        }
+        case 2: {
+            FpgaResults res{};
+            res.registers[2] = results_register();
+            return copy_out(res, data);
+        }
+        case 3: {
+            FpgaHistogram hg{};
+            hg.registers = histogram;
+            return copy_out(hg, data);
+        }
+        case 4: {
+            // one pulse on a flat baseline
+            FpgaOscilloscopeTrace trace{};
+            for (size_t i = 0; i < trace.registers.size(); ++i) {
+                double pulse = (i < 200) ? 0 : 3000 * std::exp(-(i - 200.0) / 60);
+                trace.registers[i] = static_cast<int16_t>(100 + pulse);
+            }
+            return copy_out(trace, data);
+        }
+        case 5: {
+            if (cmd.nbytes == sizeof(FpgaLmNrl1)) {
+                FpgaCtrl ctrl{};
+                auto it = stored.find({true, FpgaCtrl::mca_flags.command_ident});
+                if (it != stored.end()) {
+                    std::memcpy(&ctrl, it->second.data(), std::min(it->second.size(), sizeof(ctrl)));
+                }
+                auto& bank = nrl_banks[
+                    (ctrl.registers[NRL_BANK_SELECT_REG] & NRL_BANK_SELECT_BIT) ? 1 : 0];
+
+                // first slot is the header; the events follow it
+                FpgaLmNrl1 nrl{};
+                constexpr size_t EVT_WORDS = sizeof(NrlListDataPoint) / sizeof(uint16_t);
+                nrl.registers[0] = static_cast<uint16_t>((bank.events.size() + 1) & 0xfff);
+                std::memcpy(
+                    nrl.registers.data() + EVT_WORDS,
+                    bank.events.data(),
+                    bank.events.size() * sizeof(NrlListDataPoint)
+                );
+                bank.events.clear();
+                bank.full = false;
+                return copy_out(nrl, data);
+            }
+            FpgaListMode lm{};
+            lm.registers[0] = static_cast<uint16_t>(list_events.size());
+            size_t i = 4;
+            for (auto const& e : list_events) {
+                lm.registers[i] = static_cast<uint16_t>(e.energy_bin * 16);
+                lm.registers[i + 1] = static_cast<uint16_t>(e.rel_ts_clock_cycles);
+                lm.registers[i + 2] = static_cast<uint16_t>(e.rel_ts_clock_cycles >> 16);
+                i += 3;
+            }
+            list_events.clear();
+            return copy_out(lm, data);
+        }
+        case 8: {
+            if (cmd.nbytes != sizeof(FpgaTimeSlice)) {
+                // FpgaMap; stored
+                break;
+            }
+            FpgaTimeSlice ts{};
+            if (!slice_fifo.empty()) {
+                ts.registers = slice_fifo.front();
+                slice_fifo.pop_front();
+            }
+            return copy_out(ts, data);
+        }
+    }
+
+    std::memset(data, 0, cmd.nbytes);
+    auto it = stored.find({cmd.fpga, cmd.ident});
+    if (it != stored.end()) {
+        std::memcpy(data, it->second.data(), std::min<size_t>(cmd.nbytes, it->second.size()));
+    }
+}
+
+void SimulatedSipm3k::catch_up() {
+    if (config.manual_clock) {
+        return;
+    }
+    auto wall = clock::now();
+    auto dt = wall - last_wall;
+    last_wall = wall;
+    acquire(now, now + dt);
+    now += dt;
+}
+
+uint16_t SimulatedSipm3k::sample_energy() {
+    // a continuum with one line on top (roughly Cs-137)
+    std::bernoulli_distribution in_line{0.3};
+    double e;
+    if (in_line(rng)) {
+        e = std::normal_distribution<double>{1330, 40}(rng);
+    }
+    else {
+        e = std::exponential_distribution<double>{1.0 / 500}(rng);
+    }
+    return static_cast<uint16_t>(std::clamp(e, 0.0, 4095.0));
+}
+
+void SimulatedSipm3k::acquire(clock::duration from, clock::duration to) {
+    if (!(histogram_mode || list_mode) || to <= from) {
+        return;
+    }
+    live_ticks += static_cast<uint64_t>(seconds(to - from) * CLOCK_HZ);
+
+    // acquisition time, in seconds
+    double t0 = seconds(from - acquisition_start);
+    double t1 = seconds(to - acquisition_start);
+
+    if (histogram_mode) {
+        auto sps = config.slices_per_second;
+        auto last_slice = static_cast<uint64_t>(std::floor(t1 * sps));
+        while (slices_made < last_slice) {
+            make_slice(1.0 / sps);
+        }
+    }
+
+    if (list_mode) {
+        auto both_full = [this]() { return nrl_banks[0].full && nrl_banks[1].full; };
+        auto pps_marker = [](double t) {
+            NrlListDataPoint e{};
+            e.wall_clock_time = static_cast<uint64_t>(t * CLOCK_HZ);
+            e.was_pps = 1;
+            return e;
+        };
+
+        double t = t0;
+        while (true) {
+            // with no events there are still PPS markers
+            t = (config.event_rate > 0)
+                ? t + std::exponential_distribution<double>{config.event_rate}(rng)
+                : t1 + 1;
+            while (next_pps_second <= std::min(t, t1)) {
+                add_nrl_event(pps_marker(static_cast<double>(next_pps_second)));
+                ++next_pps_second;
+            }
+            if (t > t1) {
+                break;
+            }
+            if (both_full()) {
+                // skip making the rest
+                auto lost = poisson(rng, config.event_rate * (t1 - t)) + 1;
+                counters.nrl_events_dropped += lost;
+                counters.events += lost;
+                counts += lost;
+                break;
+            }
+
+            NrlListDataPoint e{};
+            e.energy = sample_energy();
+            e.psd = static_cast<uint16_t>(std::uniform_int_distribution<int>{0, 4095}(rng));
+            e.wall_clock_time = static_cast<uint64_t>(t * CLOCK_HZ);
+            add_nrl_event(e);
+            ++counters.events;
+            ++counts;
+            dead_ticks += 80;
+
+            if (list_events.size() < LIST_MODE_EVENTS) {
+                list_events.push_back({static_cast<uint32_t>(e.wall_clock_time), e.energy});
+            }
+        }
+        next_pps_second = std::max(next_pps_second, static_cast<uint64_t>(std::floor(t1)) + 1);
+    }
+}
+
+void SimulatedSipm3k::make_slice(double secs) {
+    auto n = poisson(rng, config.event_rate * secs);
+    ++slices_made;
+    counters.events += n;
+    counts += n;
+    dead_ticks += 80 * n;
+
+    if (slice_fifo.size() >= MAX_SLICES) {
+        ++counters.slices_dropped;
+        return;
+    }
+
+    SliceRegisters regs{};
+    constexpr size_t HIST_START = 5;
+    constexpr size_t bins = std::tuple_size_v<decltype(DecodedTimeSlice::histogram)>;
+    for (uint32_t i = 0; i < n; ++i) {
+        auto e = sample_energy();
+        ++histogram[e];
+        ++regs[HIST_START + e * bins / histogram.size()];
+    }
+    regs[0] = static_cast<uint16_t>((slices_made - 1) % config.slices_per_second);
+    regs[1] = static_cast<uint16_t>(std::min<uint32_t>(n, UINT16_MAX));
+    // a few triggers don't make it into the histogram
+    regs[2] = static_cast<uint16_t>(std::min<uint32_t>(n + n / 20, UINT16_MAX));
+    // 800 ns ticks, ~2 us per event
+    regs[3] = static_cast<uint16_t>(std::min<uint32_t>(n * 5 / 2, UINT16_MAX));
+    // 25 nA ticks
+    regs[4] = static_cast<uint16_t>(std::min<double>(n / secs / 1000, UINT16_MAX));
+
+    slice_fifo.push_back(regs);
+    ++counters.slices;
+}
+
+void SimulatedSipm3k::add_nrl_event(NrlListDataPoint const& e) {
+    if (nrl_banks[filling_bank].full) {
+        if (nrl_banks[filling_bank ^ 1].full) {
+            ++counters.nrl_events_dropped;
+            return;
+        }
+        filling_bank ^= 1;
+    }
+
+    auto& bank = nrl_banks[filling_bank];
+    bank.events.push_back(e);
+    if (bank.events.size() >= NRL_BANK_EVENTS) {
+        bank.full = true;
+        filling_bank ^= 1;
+    }
+}
+
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "IoContainer.hh"
+#include "Transport.hh"
+
+namespace SipmUsb {
+
+struct SimulatedSipm3kConfig {
+    // as ArmVersion::decode_serial_number gives it: 32 hex digits
+    std::string serial = "53494D554C41544544534950334B0001";
+    // scintillator events per second
+    double event_rate = 2000;
+    // time slices per second; 32 on the real boards
+    unsigned slices_per_second = 32;
+    uint32_t seed = 1;
+    // Only let time pass in advance(), instead of following the wall
+    // clock.  Makes tests repeatable.
+    bool manual_clock = false;
+    // How long each 256-byte chunk takes to move, like the ARM's USB
+    // buffer; zero moves data instantly
+    std::chrono::microseconds chunk_latency{0};
+};
+
+/*
+ * A Bridgeport SiPM-3000 in software, for tests and benchmarks.
+ *
+ * It speaks the same command protocol as the boards (see
+ * UsbManager::command_buffer_header): a command on CMD_OUT, then the
+ * data on DATA_OUT or DATA_IN.  Control registers read back what was
+ * written; RAM and NVRAM are the same memory here.
+ *
+ * While acquiring it makes up events at `event_rate`, with a
+ * continuum plus one line, and serves them the way the FPGA does:
+ *   - histogram mode: a FIFO of up to 127 time slices (FpgaTimeSlice),
+ *     counted in FpgaResults
+ *   - list mode: two NRL banks of 2047 events (FpgaLmNrl1), filled in
+ *     turn, each flagged full in FpgaResults until it's read.  FpgaCtrl
+ *     register 15 bit 2 picks the bank that's read.  A PPS marker
+ *     event goes in every second.
+ *   - trace mode: FpgaOscilloscopeTrace, done shortly after starting
+ */
+class SimulatedSipm3k : public Transport {
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit SimulatedSipm3k(SimulatedSipm3kConfig config = {});
+
+    int transfer(
+        int endpoint, unsigned char* buffer, int num_bytes, unsigned int timeout_ms) override;
+
+    // With manual_clock: let `dt` of acquisition time go by
+    void advance(clock::duration dt);
+
+    // Fail the next `count` transfers with `libusb_error`
+    void inject_error(int libusb_error, unsigned count = 1);
+
+    struct Stats {
+        uint64_t events = 0;
+        uint64_t slices = 0;
+        // lost because the time slice FIFO was full
+        uint64_t slices_dropped = 0;
+        // lost because both NRL banks were full
+        uint64_t nrl_events_dropped = 0;
+        uint64_t bytes_in = 0;
+        uint64_t bytes_out = 0;
+        // writes to NVRAM (flash) rather than RAM
+        uint64_t nvram_writes = 0;
+    };
+    Stats stats() const;
+
+    static constexpr size_t MAX_SLICES = 127;
+    static constexpr size_t NRL_BANK_EVENTS = 2047;
+    static constexpr size_t LIST_MODE_EVENTS = 340;
+    // wall clock ticks per second in list data
+    static constexpr uint64_t CLOCK_HZ = 40'000'000;
+
+private:
+    struct Command {
+        bool fpga;
+        bool nvram;
+        uint8_t ident;
+        uint32_t nbytes;
+    };
+
+    using SliceRegisters = FpgaTimeSlice::Registers;
+    struct NrlBank {
+        std::vector<NrlListDataPoint> events;
+        bool full = false;
+    };
+
+    mutable std::mutex mtx;
+    SimulatedSipm3kConfig config;
+    std::mt19937 rng;
+
+    // simulated time since power on, and when it was last caught up
+    clock::duration now;
+    clock::time_point last_wall;
+
+    // set by FpgaAction
+    bool histogram_mode;
+    bool list_mode;
+    bool trace_mode;
+    clock::duration acquisition_start;
+    clock::duration trace_start;
+
+    // histogram mode
+    uint64_t slices_made;
+    std::deque<SliceRegisters> slice_fifo;
+    std::array<uint32_t, 4096> histogram;
+
+    // list mode
+    std::array<NrlBank, 2> nrl_banks;
+    size_t filling_bank;
+    uint64_t next_pps_second;
+    std::vector<ListModeDataPoint> list_events;
+
+    // for FpgaStatistics
+    uint64_t live_ticks;
+    uint32_t counts;
+    uint32_t dead_ticks;
+
+    // registers that just hold whatever was written, by (fpga, ident)
+    std::map<std::pair<bool, uint8_t>, std::vector<unsigned char>> stored;
+
+    std::optional<Command> pending_read;
+    std::optional<Command> pending_write;
+
+    int error_to_inject;
+    unsigned errors_left;
+    Stats counters;
+
+    void catch_up();
+    void acquire(clock::duration from, clock::duration to);
+    void make_slice(double seconds);
+    void add_nrl_event(NrlListDataPoint const& e);
+    uint16_t sample_energy();
+    void clear_acquisition();
+
+    int handle_command(unsigned char const* buffer, int num_bytes);
+    void apply_write(Command const& cmd, unsigned char const* data, size_t size);
+    void serve_read(Command const& cmd, unsigned char* data);
+    uint16_t results_register() const;
+    size_t register_bytes(bool fpga, uint8_t ident) const;
+};
+
+}
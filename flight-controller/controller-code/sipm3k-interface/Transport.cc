@@ -0,0 +1,84 @@
+#include <sstream>
+
+#include "logging.hh"
+#include "Transport.hh"
+
+namespace SipmUsb
+{
+
+void Transport::transfer_mode(TransferMode, size_t) { }
+
+TransferMode Transport::transfer_mode() const {
+    return TransferMode::synchronous;
+}
+
+std::optional<LibUsbCpp::UsbLocation> Transport::location() const {
+    return {};
+}
+
+
+LibUsbTransport::LibUsbTransport(std::shared_ptr<LibUsbCpp::DeviceHandle> device_handle_) :
+    device_handle(std::move(device_handle_)),
+    pipeline()
+{ }
+
+void LibUsbTransport::transfer_mode(TransferMode mode, size_t depth) {
+    if (mode == TransferMode::synchronous) {
+        pipeline.reset();
+        return;
+    }
+    device_handle->context()->start_event_thread();
+    pipeline = std::make_unique<AsyncChunkTransfer>(device_handle->handle, depth);
+}
+
+TransferMode LibUsbTransport::transfer_mode() const {
+    return pipeline ? TransferMode::pipelined : TransferMode::synchronous;
+}
+
+std::optional<LibUsbCpp::UsbLocation> LibUsbTransport::location() const {
+    return device_handle->location();
+}
+
+int LibUsbTransport::transfer(
+    int endpoint, unsigned char* buffer, int num_bytes, unsigned int timeout)
+{
+    libusb_device_handle* han = device_handle->handle;
+
+    // ARM processor inside detector only has 256-byte buffer
+    static const int CHUNK_SZ = 256;
+
+    if (pipeline) {
+        return pipeline->run(
+            static_cast<unsigned char>(endpoint), buffer, num_bytes, CHUNK_SZ, timeout);
+    }
+    int nchunks = num_bytes / CHUNK_SZ;
+    int leftover = num_bytes % CHUNK_SZ;
+    int ret = 0;
+    int transferred = 0;
+
+    // transfer the 256 byte chunks
+    for (int i = 0; i < nchunks; ++i) {
+        ret = libusb_bulk_transfer(han, endpoint, buffer + i*CHUNK_SZ, CHUNK_SZ, &transferred, timeout);
+        if (transferred != CHUNK_SZ) {
+            std::stringstream ss;
+            ss << "didn't read/write appropriate chunk size: " << transferred << " vs " << CHUNK_SZ << ". " << libusb_strerror(ret);
+            log_error(ss.str());
+        }
+        if (ret < 0) return ret;
+    }
+
+    transferred = 0;
+    // transfer the rest
+    if (leftover != 0) {
+        ret = libusb_bulk_transfer(han, endpoint, buffer + nchunks*CHUNK_SZ, leftover, &transferred, timeout);
+        if (transferred != leftover) {
+            std::stringstream ss;
+            ss << "didn't read/write appropriate leftover: " << transferred << " vs " << leftover << ". " << libusb_strerror(ret);
+            log_error(ss.str());
+        }
+        if (ret < 0) return ret;
+    }
+    return 0;
+}
+
+}
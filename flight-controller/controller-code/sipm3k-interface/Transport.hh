@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+
+#include "AsyncTransfer.hh"
+#include "LibUsbCpp.hh"
+
+namespace SipmUsb {
+
+enum class TransferMode {
+    // one blocking libusb_bulk_transfer per chunk
+    synchronous,
+    // several chunks in flight at once (see AsyncChunkTransfer)
+    pipelined,
+};
+
+/*
+ * How UsbManager reaches a board: bulk transfers on its endpoints,
+ * carrying the Bridgeport command protocol.  LibUsbTransport is the
+ * real hardware; SimulatedSipm3k stands in for it in tests and
+ * benchmarks.
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    // Move `num_bytes` to or from `endpoint` (its direction bit says
+    // which).  Returns 0, or a negative libusb error code.
+    virtual int transfer(
+        int endpoint, unsigned char* buffer, int num_bytes, unsigned int timeout_ms) = 0;
+
+    // Only real hardware can pipeline; by default this is ignored
+    virtual void transfer_mode(TransferMode mode, size_t depth);
+    virtual TransferMode transfer_mode() const;
+
+    // Where the board is on the bus, if it's on one
+    virtual std::optional<LibUsbCpp::UsbLocation> location() const;
+};
+
+class LibUsbTransport : public Transport {
+public:
+    explicit LibUsbTransport(std::shared_ptr<LibUsbCpp::DeviceHandle> device_handle);
+
+    int transfer(
+        int endpoint, unsigned char* buffer, int num_bytes, unsigned int timeout_ms) override;
+
+    void transfer_mode(TransferMode mode, size_t depth) override;
+    TransferMode transfer_mode() const override;
+    std::optional<LibUsbCpp::UsbLocation> location() const override;
+
+private:
+    std::shared_ptr<LibUsbCpp::DeviceHandle> device_handle;
+    // only set in pipelined mode
+    std::unique_ptr<AsyncChunkTransfer> pipeline;
+};
+
+}
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <mutex>
 #include <sstream>
 
 #include "IoContainer.hh"
@@ -8,8 +9,12 @@
 namespace SipmUsb
 {
 
-UsbManager::UsbManager(std::shared_ptr<LibUsbCpp::DeviceHandle> device_handle_) :
-    device_handle(device_handle_),
+UsbManager::UsbManager(std::shared_ptr<LibUsbCpp::DeviceHandle> device_handle) :
+    UsbManager(std::make_shared<LibUsbTransport>(std::move(device_handle)))
+{ }
+
+UsbManager::UsbManager(std::shared_ptr<Transport> transport_) :
+    transport(std::move(transport_)),
     arm_serial("Unknown serial number")
 {
     ArmVersion armvc;
@@ -21,46 +26,73 @@ std::string UsbManager::get_arm_serial() const {
     return arm_serial;
 }
 
-int UsbManager::xfer_in_chunks(int endpoint, void* raw_buffer, int num_bytes, int timeout)
-{
-    // wow
-    unsigned char* buffer = (unsigned char*) raw_buffer; 
-    libusb_device_handle* han = device_handle->handle;
-
-    // ARM processor inside detector only has 256-byte buffer
-    static const int CHUNK_SZ = 256;
-    int nchunks = num_bytes / CHUNK_SZ;
-    int leftover = num_bytes % CHUNK_SZ;
-    int ret = 0;
-    int transferred = 0;
-
-    // transfer the 256 byte chunks
-    for (int i = 0; i < nchunks; ++i) {
-        ret = libusb_bulk_transfer(han, endpoint, buffer + i*CHUNK_SZ, CHUNK_SZ, &transferred, timeout);
-        if (transferred != CHUNK_SZ) {
-            std::stringstream ss;
-            ss << "didn't read/write appropriate chunk size: " << transferred << " vs " << CHUNK_SZ << ". " << libusb_strerror(ret);
-            log_error(ss.str());
-        }
-        if (ret < 0) return ret;
+void UsbManager::transfer_mode(TransferMode mode, size_t depth) {
+    if (transport) {
+        transport->transfer_mode(mode, depth);
     }
+}
 
-    transferred = 0;
-    // transfer the rest
-    if (leftover != 0) {
-        ret = libusb_bulk_transfer(han, endpoint, buffer + nchunks*CHUNK_SZ, leftover, &transferred, timeout);
-        if (transferred != leftover) {
-            std::stringstream ss;
-            ss << "didn't read/write appropriate leftover: " << transferred << " vs " << leftover << ". " << libusb_strerror(ret);
-            log_error(ss.str());
-        }
-        if (ret < 0) return ret;
+TransferMode UsbManager::transfer_mode() const {
+    return transport ? transport->transfer_mode() : TransferMode::synchronous;
+}
+
+void UsbManager::close() {
+    transport.reset();
+}
+
+std::optional<LibUsbCpp::UsbLocation> UsbManager::location() const {
+    if (!transport) {
+        return {};
+    }
+    return transport->location();
+}
+
+void UsbManager::read_with(CommandBuffer_t const& command_buffer, void* data, int num_bytes) {
+    // Casting away const for the transfer; an OUT endpoint only reads it
+    int xfer_ret = xfer_in_chunks(
+        CMD_OUT_EP, const_cast<std::byte*>(command_buffer.data()),
+        sizeof(command_buffer), TIMEOUT_MS);
+
+    if (xfer_ret < 0) {
+        std::stringstream ss;
+        ss << "Error writing cmd to handle specified by SN "
+            << arm_serial << ": "
+            << libusb_strerror(xfer_ret);
+        throw LibUsbCpp::UsbException(ss.str().c_str());
+    }
+
+    // read the actual data now
+    xfer_ret = xfer_in_chunks(DATA_IN_EP, data, num_bytes, TIMEOUT_MS);
+
+    if (xfer_ret < 0) {
+        std::stringstream ss;
+        ss << "Error reading data from handle specified by SN "
+            << arm_serial << ": "
+            << libusb_strerror(xfer_ret);
+        throw LibUsbCpp::UsbException(ss.str().c_str());
     }
-    return 0;
 }
 
+int UsbManager::xfer_in_chunks(int endpoint, void* buffer, int num_bytes, int timeout)
+{
+    if (!transport) {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    return transport->transfer(
+        endpoint, static_cast<unsigned char*>(buffer), num_bytes, timeout);
+}
+
+
+BridgeportDeviceManager::BridgeportDeviceManager(
+    size_t pipeline_depth,
+    std::optional<std::string> only_serial
+) {
+    // Every free board is claimed for a moment to read its serial
+    // number, so two enumerations at once (e.g. two boards being
+    // reconnected) could each hide the other's board.
+    static std::mutex enumerate_mtx;
+    std::lock_guard lock{enumerate_mtx};
 
-BridgeportDeviceManager::BridgeportDeviceManager() {
     auto usb_ctx = std::make_shared<LibUsbCpp::Context>();
     auto device_list = LibUsbCpp::DeviceList(usb_ctx);
 
@@ -78,11 +110,22 @@ BridgeportDeviceManager::BridgeportDeviceManager() {
         if (desc.idVendor == BRIDGEPORT_VID) {
             auto device_handle = std::make_shared<LibUsbCpp::DeviceHandle>(dev, usb_ctx);
             if (!device_handle->claim_interface(DETECTOR_INTERFACE)) {
-                return;
+                // already in use; look at the rest
+                continue;
             }
 
             auto usb_manager = std::make_shared<UsbManager>(device_handle);
-            device_map[usb_manager->get_arm_serial()] = usb_manager;
+            auto sn = usb_manager->get_arm_serial();
+            if (only_serial && sn != *only_serial) {
+                continue;
+            }
+            if (pipeline_depth > 0) {
+                usb_manager->transfer_mode(TransferMode::pipelined, pipeline_depth);
+            }
+            device_map[sn] = usb_manager;
+            if (only_serial) {
+                break;
+            }
         }
     }
     log_debug("Serial numbers available");
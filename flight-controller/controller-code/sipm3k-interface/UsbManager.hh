@@ -4,10 +4,13 @@
 #include <cstring>
 #include <map>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
 #include "LibUsbCpp.hh"
+#include "Transport.hh"
 
 namespace SipmUsb {
 
@@ -19,9 +22,27 @@ enum class MemoryType {
 class UsbManager {
 public:
     explicit UsbManager(std::shared_ptr<LibUsbCpp::DeviceHandle> device_handle);
+    // e.g. a SimulatedSipm3k
+    explicit UsbManager(std::shared_ptr<Transport> transport);
 
     std::string get_arm_serial() const;
 
+    // How read() and write() move data.  Pipelining starts the USB
+    // context's event thread; `depth` is how many 256-byte chunks may
+    // be in flight at once.
+    void transfer_mode(TransferMode mode, size_t depth = DEFAULT_PIPELINE_DEPTH);
+    TransferMode transfer_mode() const;
+
+    static constexpr size_t DEFAULT_PIPELINE_DEPTH = 4;
+
+    // Let go of the board so it can be found and claimed again (see
+    // BridgeportDeviceManager).  Any transfer after this fails with
+    // LIBUSB_ERROR_NO_DEVICE.
+    void close();
+
+    // Where the board is on the bus; nothing once closed
+    std::optional<LibUsbCpp::UsbLocation> location() const;
+
     // writes settings or data from the IoContainer
     template<typename ContainerT>
     void write(ContainerT const& con, MemoryType memory_type) {
@@ -83,42 +104,19 @@ public:
     // reads data into the IoContainer
     template<typename ContainerT>
     void read(ContainerT &con, MemoryType memory_type) {
-        // Construct command buffer
         static_assert(std::is_trivial_v<ContainerT>);
-        static_assert(std::is_trivial_v<CommandBuffer_t>);
-        auto header = command_buffer_header(
-            sizeof(con),
-            static_cast<uint32_t>(memory_type),
-            ContainerT::mca_flags.command_ident,
-            ContainerT::mca_flags.read_type
-        );
-        CommandBuffer_t command_buffer;
-        memcpy(&command_buffer, &header, sizeof(header));
-
-        // send command saying, "hi, i want data"
-        int xfer_ret = xfer_in_chunks(
-            CMD_OUT_EP, command_buffer.data(),
-            sizeof(command_buffer), TIMEOUT_MS);
-
-        if (xfer_ret < 0) {
-            std::stringstream ss;
-            ss << "Error writing cmd to handle specified by SN "
-                << arm_serial << ": "
-                << libusb_strerror(xfer_ret);
-            throw LibUsbCpp::UsbException(ss.str().c_str());
-        }
-
-        // read the actual data now
-        xfer_ret = xfer_in_chunks(
-            DATA_IN_EP, &con,
-            sizeof(con), TIMEOUT_MS);
+        read_with(read_command<ContainerT>(memory_type), &con, sizeof(con));
+    }
 
-        if (xfer_ret < 0) {
-            std::stringstream ss;
-            ss << "Error reading data from handle specified by SN "
-                << arm_serial << ": "
-                << libusb_strerror(xfer_ret);
-            throw LibUsbCpp::UsbException(ss.str().c_str());
+    // Reads into each of `cons` in turn, e.g. everything waiting in a
+    // FIFO.  The command is built once and the reads go back to back,
+    // with nothing else in between.
+    template<typename ContainerT>
+    void read_each(std::span<ContainerT> cons, MemoryType memory_type) {
+        static_assert(std::is_trivial_v<ContainerT>);
+        auto command_buffer = read_command<ContainerT>(memory_type);
+        for (auto& con : cons) {
+            read_with(command_buffer, &con, sizeof(con));
         }
     }
 
@@ -138,7 +136,25 @@ private:
             transfer_flags;
     }
 
-    std::shared_ptr<LibUsbCpp::DeviceHandle> device_handle;
+    template<typename ContainerT>
+    CommandBuffer_t read_command(MemoryType memory_type) {
+        static_assert(std::is_trivial_v<CommandBuffer_t>);
+        auto header = command_buffer_header(
+            sizeof(ContainerT),
+            static_cast<uint32_t>(memory_type),
+            ContainerT::mca_flags.command_ident,
+            ContainerT::mca_flags.read_type
+        );
+        CommandBuffer_t command_buffer;
+        memcpy(&command_buffer, &header, sizeof(header));
+        return command_buffer;
+    }
+
+    // send command saying, "hi, i want data", then read the data
+    void read_with(CommandBuffer_t const& command_buffer, void* data, int num_bytes);
+
+    // null once closed
+    std::shared_ptr<Transport> transport;
     std::string arm_serial;
 
     int xfer_in_chunks(int endpoint, void* buffer, int num_bytes, int timeout);
@@ -155,7 +171,13 @@ private:
 struct BridgeportDeviceManager {
     std::map<std::string, std::shared_ptr<UsbManager>> device_map;
 
-    BridgeportDeviceManager();
+    // pipeline_depth > 0 puts every device in pipelined transfer mode.
+    // Given `only_serial`, stops at that board and keeps nothing else.
+    // Boards already claimed (e.g. by a connected HafxControl) are
+    // skipped.
+    explicit BridgeportDeviceManager(
+        size_t pipeline_depth = 0,
+        std::optional<std::string> only_serial = {});
 
     static constexpr int DETECTOR_INTERFACE = 1;
     static constexpr uint16_t BRIDGEPORT_VID = 0x1fa4;
@@ -0,0 +1,62 @@
+#include "Widen.hh"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace SipmUsb {
+
+namespace {
+void widen_scalar(uint16_t const* in, size_t begin, size_t end, unsigned char* out) {
+    for (size_t i = begin; i < end; ++i) {
+        uint32_t wide = in[i];
+        std::memcpy(out + i * sizeof(wide), &wide, sizeof(wide));
+    }
+}
+
+// eight values in, 32 bytes out, per step
+constexpr size_t STEP = 8;
+}
+
+void widen_u16_to_u32(std::span<const uint16_t> in, unsigned char* out) {
+    size_t n = in.size();
+    size_t vec_end = n - (n % STEP);
+    uint16_t const* src = in.data();
+
+#if defined(__AVX2__)
+    for (size_t i = 0; i < vec_end; i += STEP) {
+        __m128i narrow = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i*>(out + i * sizeof(uint32_t)),
+            _mm256_cvtepu16_epi32(narrow));
+    }
+#elif defined(__SSE2__)
+    __m128i const zero = _mm_setzero_si128();
+    for (size_t i = 0; i < vec_end; i += STEP) {
+        __m128i narrow = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        auto dst = reinterpret_cast<__m128i*>(out + i * sizeof(uint32_t));
+        _mm_storeu_si128(dst, _mm_unpacklo_epi16(narrow, zero));
+        _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(narrow, zero));
+    }
+#elif defined(__ARM_NEON)
+    for (size_t i = 0; i < vec_end; i += STEP) {
+        uint16x8_t narrow = vld1q_u16(src + i);
+        // byte stores: `out` may not be 4-byte aligned
+        unsigned char* dst = out + i * sizeof(uint32_t);
+        vst1q_u8(dst, vreinterpretq_u8_u32(vmovl_u16(vget_low_u16(narrow))));
+        vst1q_u8(dst + 16, vreinterpretq_u8_u32(vmovl_u16(vget_high_u16(narrow))));
+    }
+#else
+    vec_end = 0;
+#endif
+
+    widen_scalar(src, vec_end, n, out);
+}
+
+}
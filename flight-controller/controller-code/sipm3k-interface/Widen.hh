@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+namespace SipmUsb {
+
+/*
+ * Zero-extend each of `in` to 32 bits and store them one after
+ * another (host byte order) at `out`, which needs room for
+ * 4 * in.size() bytes and no particular alignment -- e.g. a
+ * histogram inside a packed science struct.
+ *
+ * AVX2, SSE2 or NEON when the compiler targets them, plain C++
+ * otherwise.
+ */
+void widen_u16_to_u32(std::span<const uint16_t> in, unsigned char* out);
+
+}
@@ -0,0 +1,309 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <random>
+
+#include <IoContainer.hh>
+#include <NrlScan.hh>
+#include <SimulatedSipm3k.hh>
+#include <UsbManager.hh>
+#include <Widen.hh>
+
+using namespace std::chrono_literals;
+using namespace SipmUsb;
+
+namespace {
+struct Sim {
+    std::shared_ptr<SimulatedSipm3k> board;
+    UsbManager usb;
+
+    explicit Sim(SimulatedSipm3kConfig config = {}) :
+        board{std::make_shared<SimulatedSipm3k>(std::move(config))},
+        usb{board}
+    { }
+};
+
+SimulatedSipm3kConfig manual(double event_rate = 2000) {
+    return SimulatedSipm3kConfig{.event_rate = event_rate, .manual_clock = true};
+}
+
+void select_nrl_bank(UsbManager& usb, uint16_t bank) {
+    FpgaCtrl ctrl{};
+    usb.read(ctrl, MemoryType::ram);
+    ctrl.registers[15] = (ctrl.registers[15] & ~4) | (bank << 2);
+    usb.write(ctrl, MemoryType::nvram);
+}
+}
+
+TEST(SimulatedSipm3k, ReportsSerial) {
+    SimulatedSipm3kConfig config{.serial = "0123456789ABCDEF0123456789ABCDEF"};
+    Sim sim{config};
+    EXPECT_EQ(sim.usb.get_arm_serial(), config.serial);
+}
+
+TEST(SimulatedSipm3k, SettingsReadBack) {
+    Sim sim{manual()};
+
+    FpgaCtrl fc{};
+    fc.registers[3] = 1234;
+    sim.usb.write(fc, MemoryType::ram);
+    FpgaCtrl fc_back{};
+    sim.usb.read(fc_back, MemoryType::ram);
+    EXPECT_EQ(fc_back.registers, fc.registers);
+
+    // too big for a short write
+    ArmCtrl ac{};
+    ac.registers[10] = 2.5f;
+    sim.usb.write(ac, MemoryType::ram);
+    ArmCtrl ac_back{};
+    sim.usb.read(ac_back, MemoryType::ram);
+    EXPECT_EQ(ac_back.registers, ac.registers);
+}
+
+TEST(SimulatedSipm3k, TimeSlicesFillFifo) {
+    Sim sim{manual()};
+    sim.usb.write(FPGA_ACTION_START_NEW_HISTOGRAM_ACQUISITION, MemoryType::ram);
+
+    sim.board->advance(1s);
+    FpgaResults res{};
+    sim.usb.read(res, MemoryType::ram);
+    ASSERT_EQ(res.num_avail_time_slices(), 32);
+
+    uint32_t events = 0;
+    for (uint16_t i = 0; i < 32; ++i) {
+        FpgaTimeSlice ts{};
+        sim.usb.read(ts, MemoryType::ram);
+        auto dec = ts.decode();
+        EXPECT_EQ(dec.buffer_number, i);
+        uint32_t in_hist = 0;
+        for (auto c : dec.histogram) in_hist += c;
+        EXPECT_EQ(in_hist, dec.num_evts);
+        events += dec.num_evts;
+    }
+    // 2000 per second, give or take
+    EXPECT_NEAR(events, 2000, 250);
+
+    sim.usb.read(res, MemoryType::ram);
+    EXPECT_EQ(res.num_avail_time_slices(), 0);
+
+    // nobody reads out for 5 s: the FIFO tops out and the rest is lost
+    sim.board->advance(5s);
+    sim.usb.read(res, MemoryType::ram);
+    EXPECT_EQ(res.num_avail_time_slices(), SimulatedSipm3k::MAX_SLICES);
+    EXPECT_EQ(sim.board->stats().slices_dropped, 5 * 32 - SimulatedSipm3k::MAX_SLICES);
+}
+
+TEST(SimulatedSipm3k, NrlBanksFillInTurn) {
+    // 3000 events in 1 s: bank 0 fills, bank 1 gets the rest
+    Sim sim{manual(3000)};
+    sim.usb.write(FPGA_ACTION_START_NEW_LIST_ACQUISITION, MemoryType::ram);
+    sim.board->advance(1100ms);
+
+    FpgaResults res{};
+    sim.usb.read(res, MemoryType::ram);
+    ASSERT_TRUE(res.nrl_buffer_full(0));
+    EXPECT_FALSE(res.nrl_buffer_full(1));
+
+    select_nrl_bank(sim.usb, 0);
+    auto nrl = std::make_unique<FpgaLmNrl1>();
+    sim.usb.read(*nrl, MemoryType::ram);
+    auto events = nrl->decode();
+    ASSERT_EQ(events.size(), SimulatedSipm3k::NRL_BANK_EVENTS);
+
+    uint64_t last = 0;
+    for (auto const& e : events) {
+        EXPECT_GE(e.wall_clock_time, last);
+        last = e.wall_clock_time;
+    }
+
+    sim.usb.read(res, MemoryType::ram);
+    EXPECT_FALSE(res.nrl_buffer_full(0));
+
+    // the PPS marker at 1 s went into bank 1
+    select_nrl_bank(sim.usb, 1);
+    sim.usb.read(*nrl, MemoryType::ram);
+    events = nrl->decode();
+    ASSERT_FALSE(events.empty());
+    size_t pps = 0;
+    for (auto const& e : events) {
+        if (e.was_pps) {
+            ++pps;
+            EXPECT_EQ(e.wall_clock_time, SimulatedSipm3k::CLOCK_HZ);
+        }
+    }
+    EXPECT_EQ(pps, 1u);
+    EXPECT_EQ(sim.board->stats().nrl_events_dropped, 0u);
+}
+
+TEST(SimulatedSipm3k, NrlEventBytesMatchDecode) {
+    Sim sim{manual(1000)};
+    sim.usb.write(FPGA_ACTION_START_NEW_LIST_ACQUISITION, MemoryType::ram);
+    sim.board->advance(1500ms);
+
+    select_nrl_bank(sim.usb, 0);
+    auto nrl = std::make_unique<FpgaLmNrl1>();
+    sim.usb.read(*nrl, MemoryType::ram);
+    auto events = nrl->decode();
+    ASSERT_GT(events.size(), 0u);
+    ASSERT_EQ(nrl->num_events(), events.size());
+
+    auto raw = nrl->event_bytes();
+    ASSERT_EQ(raw.size(), events.size() * sizeof(NrlListDataPoint));
+    EXPECT_EQ(std::memcmp(raw.data(), events.data(), raw.size()), 0);
+    EXPECT_TRUE(nrl->has_pps());
+
+    // without the PPS marker
+    for (size_t i = 0; i < events.size(); ++i) {
+        if (events[i].was_pps) {
+            events[i].was_pps = 0;
+            std::memcpy(nrl->registers.data() + 6 * (i + 1), &events[i], sizeof(events[i]));
+        }
+    }
+    EXPECT_FALSE(nrl->has_pps());
+
+    // a count past the end of the buffer is cut off
+    EXPECT_FALSE(nrl->count_clamped());
+    nrl->registers[0] = 0xfff;
+    EXPECT_EQ(nrl->num_events(), 2047u);
+    EXPECT_TRUE(nrl->count_clamped());
+}
+
+TEST(SimulatedSipm3k, NrlDecodeIntoStaysInBounds) {
+    Sim sim{manual(1000)};
+    sim.usb.write(FPGA_ACTION_START_NEW_LIST_ACQUISITION, MemoryType::ram);
+    sim.board->advance(1500ms);
+
+    select_nrl_bank(sim.usb, 0);
+    auto nrl = std::make_unique<FpgaLmNrl1>();
+    sim.usb.read(*nrl, MemoryType::ram);
+    auto expect = nrl->decode();
+    ASSERT_EQ(expect.size(), nrl->num_events());
+
+    auto out = std::make_unique<NrlEventArray>();
+    auto dec = nrl->decode_into(*out);
+    EXPECT_FALSE(dec.count_clamped);
+    EXPECT_EQ(dec.events.data(), out->data());
+    ASSERT_EQ(dec.events.size(), expect.size());
+    EXPECT_EQ(std::memcmp(dec.events.data(), expect.data(), expect.size() * sizeof(expect[0])), 0);
+
+    // only as many as there's room for
+    std::array<NrlListDataPoint, 10> small;
+    dec = nrl->decode_into(small);
+    ASSERT_EQ(dec.events.size(), small.size());
+    EXPECT_EQ(std::memcmp(small.data(), expect.data(), sizeof(small)), 0);
+
+    // a corrupt header: flagged, and nothing past the bank is read
+    nrl->registers[0] = 4000;
+    dec = nrl->decode_into(*out);
+    EXPECT_TRUE(dec.count_clamped);
+    EXPECT_EQ(dec.events.size(), FpgaLmNrl1::MAX_EVENTS);
+    EXPECT_EQ(nrl->decode().size(), FpgaLmNrl1::MAX_EVENTS);
+
+    // empty banks, with and without the header slot
+    for (uint16_t slots : {0, 1}) {
+        nrl->registers[0] = slots;
+        dec = nrl->decode_into(*out);
+        EXPECT_TRUE(dec.events.empty());
+        EXPECT_FALSE(dec.count_clamped);
+    }
+}
+
+TEST(NrlScan, FlagCountsMatchDecode) {
+    // random bits everywhere, so every flag turns up; odd counts leave
+    // a tail after the vector kernel
+    for (uint16_t num_evts : {0, 1, 13, 1000, 2047}) {
+        auto nrl = std::make_unique<FpgaLmNrl1>();
+        std::mt19937 rng{num_evts};
+        for (auto& r : nrl->registers) {
+            r = static_cast<uint16_t>(rng());
+        }
+        nrl->registers[0] = num_evts + 1;
+
+        NrlFlagCounts expect{};
+        std::vector<uint16_t> expect_pps;
+        auto events = nrl->decode();
+        for (size_t i = 0; i < events.size(); ++i) {
+            auto const& e = events[i];
+            expect.external_trigger += e.external_trigger;
+            expect.piled_up += e.piled_up;
+            expect.sum_overflow += e.sum_overflow;
+            expect.out_of_range += e.out_of_range;
+            if (e.was_pps) {
+                ++expect.pps;
+                expect_pps.push_back(static_cast<uint16_t>(i));
+            }
+        }
+
+        std::vector<uint16_t> pps(2047);
+        auto counts = scan_nrl_flags(nrl->event_bytes(), pps);
+        EXPECT_EQ(counts, expect) << num_evts << " events";
+        pps.resize(counts.pps);
+        EXPECT_EQ(pps, expect_pps) << num_evts << " events";
+
+        // no room for the indices: still counted
+        EXPECT_EQ(scan_nrl_flags(nrl->event_bytes()), expect);
+    }
+}
+
+TEST(Widen, MatchesScalar) {
+    std::mt19937 rng{7};
+    std::vector<uint16_t> in(128);
+    for (auto& v : in) {
+        v = static_cast<uint16_t>(rng());
+    }
+
+    // odd lengths leave a tail after the vector kernel; odd offsets
+    // are what a packed struct gives it
+    for (size_t n : {0, 1, 7, 8, 9, 123, 128}) {
+        for (size_t offset : {0, 1, 3}) {
+            std::vector<unsigned char> out(offset + 4 * n + 1, 0xa5);
+            widen_u16_to_u32(std::span{in}.first(n), out.data() + offset);
+
+            for (size_t i = 0; i < n; ++i) {
+                uint32_t got;
+                std::memcpy(&got, out.data() + offset + 4 * i, sizeof(got));
+                ASSERT_EQ(got, in[i]) << n << " values at offset " << offset << ", index " << i;
+            }
+            // nothing past the end
+            EXPECT_EQ(out.back(), 0xa5);
+            if (offset > 0) {
+                EXPECT_EQ(out[offset - 1], 0xa5);
+            }
+        }
+    }
+}
+
+TEST(SimulatedSipm3k, NrlDropsWhenBothBanksFull) {
+    Sim sim{manual(10000)};
+    sim.usb.write(FPGA_ACTION_START_NEW_LIST_ACQUISITION, MemoryType::ram);
+    sim.board->advance(1s);
+
+    FpgaResults res{};
+    sim.usb.read(res, MemoryType::ram);
+    EXPECT_TRUE(res.nrl_buffer_full(0));
+    EXPECT_TRUE(res.nrl_buffer_full(1));
+    EXPECT_GT(sim.board->stats().nrl_events_dropped, 0u);
+}
+
+TEST(SimulatedSipm3k, InjectedErrorsThrow) {
+    Sim sim{manual()};
+    sim.board->inject_error(LIBUSB_ERROR_PIPE);
+
+    FpgaResults res{};
+    EXPECT_THROW(sim.usb.read(res, MemoryType::ram), LibUsbCpp::UsbException);
+    // only the once
+    EXPECT_NO_THROW(sim.usb.read(res, MemoryType::ram));
+}
+
+TEST(SimulatedSipm3k, ClosedManagerStopsTalking) {
+    Sim sim{manual()};
+    sim.usb.close();
+    FpgaResults res{};
+    EXPECT_THROW(sim.usb.read(res, MemoryType::ram), LibUsbCpp::UsbException);
+}
+
+int main(int argc, char *argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
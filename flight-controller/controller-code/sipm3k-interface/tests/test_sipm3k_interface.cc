@@ -161,6 +161,26 @@ TEST(sipm3k, FillListBufferAndRead) {
     SUCCEED();
 }
 
+TEST(sipm3k, ReconnectOneBoard) {
+    using namespace SipmUsb;
+    BridgeportDeviceManager all;
+    ASSERT_FALSE(all.device_map.empty()) << "no device connected";
+    auto [sn, held] = *all.device_map.begin();
+
+    // boards we already hold are skipped, not an error
+    BridgeportDeviceManager again;
+    EXPECT_FALSE(again.device_map.contains(sn));
+
+    // once let go, the same board can be found on its own
+    held->close();
+    FpgaResults res{};
+    EXPECT_THROW(held->read(res, MemoryType::ram), LibUsbCpp::UsbException);
+
+    BridgeportDeviceManager one{0, sn};
+    ASSERT_EQ(one.device_map.size(), 1u);
+    one.device_map.at(sn)->read(res, MemoryType::ram);
+}
+
 
 // TODO add more tests for each container
 // maybe template?
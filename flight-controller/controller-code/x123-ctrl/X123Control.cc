@@ -8,7 +8,11 @@ namespace res = X123Driver::Packets::Responses;
 namespace Detector {
 
 X123Control::X123Control(DetectorPorts ports) :
-    driver{std::make_unique<X123DriverWrap>()},
+    X123Control(ports, std::make_unique<X123DriverWrap>())
+{ }
+
+X123Control::X123Control(DetectorPorts ports, std::unique_ptr<X123DriverWrap> driver_) :
+    driver{std::move(driver_)},
     local_next_buffer_num{0},
     science_saver{std::make_unique<DataSaver>(ports.science)},
     debug_saver{std::make_unique<DataSaver>(ports.debug)},
@@ -85,7 +89,7 @@ void X123Control::read_save_sequential_buffer() {
     auto spectrum_span = buffer_span.subspan(0, buffer_span.size() - res::Status::SIZE);
     auto status_span = buffer_span.subspan(buffer_span.size() - res::Status::SIZE, res::Status::SIZE);
 
-    auto rebinned_spectrum = rebin_spectrum(assemble_spectrum(spectrum_span));
+    auto rebinned_spectrum = rebin_spectrum(assemble_spectrum(spectrum_span), settings);
 
     // Need "normal" status, not the one associated with the 
     // spectrum+status of the HCSBO buffer
@@ -129,7 +133,7 @@ void X123Control::stop_sequential_buffering() {
 }
 
 std::vector<uint32_t>
-X123Control::assemble_spectrum(std::span<const uint8_t> buf) {
+assemble_spectrum(std::span<const uint8_t> buf) {
     std::vector<uint32_t> assembled;
 
     for (size_t i = 0; i < buf.size(); i += 3) {
@@ -141,23 +145,26 @@ X123Control::assemble_spectrum(std::span<const uint8_t> buf) {
 }
 
 std::vector<uint32_t>
-X123Control::rebin_spectrum(std::vector<uint32_t> const& orig_spectrum) {
+rebin_spectrum(
+    std::vector<uint32_t> const& orig_spectrum,
+    DetectorMessages::X123Settings const& settings
+) {
     // if no edges given, do not rebin
     if (!settings.adc_rebin_edges_length) {
         return orig_spectrum;
     }
 
     const auto& rebin_edges = settings.adc_rebin_edges;
+    // minus 1 because edges come in pairs
+    size_t limit = settings.adc_rebin_edges_length - 1;
 
-    for (const auto& e : orig_spectrum) {
-        if (e > orig_spectrum.size()) {
+    for (size_t i = 0; i <= limit; ++i) {
+        if (rebin_edges[i] > orig_spectrum.size()) {
             throw DetectorException{"X123 rebin edges out of bounds"};
         }
     }
 
     std::vector<uint32_t> ret;
-    // minus 1 because edges come in pairs
-    size_t limit = settings.adc_rebin_edges_length - 1;
     for (size_t edge_idx = 0; edge_idx < limit; ++edge_idx) {
         const auto start_bin_edge = rebin_edges[edge_idx];
         const auto stop_bin_edge = rebin_edges[edge_idx+1];
@@ -348,6 +355,14 @@ bool X123Control::driver_valid() const {
     return driver->valid();
 }
 
+void X123Control::reconnect() {
+    driver->reconnect();
+    if (!driver->valid()) {
+        throw DetectorException{"X-123 not found on the bus"};
+    }
+    log_info("X-123 reconnected");
+}
+
 void X123Control::num_histogram_bins_from_ram() {
     auto extract_bins = [](std::string const& s) {
         auto tok_loc = s.find("MCAC=");
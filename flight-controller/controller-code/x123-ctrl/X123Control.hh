@@ -26,6 +26,8 @@ namespace Detector {
 class X123Control {
 public:
     X123Control(DetectorPorts ports);
+    // e.g. with a driver on a SimulatedX123
+    X123Control(DetectorPorts ports, std::unique_ptr<X123DriverWrap> driver);
     ~X123Control();
 
     DetectorMessages::X123Health
@@ -50,6 +52,10 @@ public:
 
     bool driver_valid() const;
 
+    // Reopen the USB connection, keeping the time anchor and buffer
+    // count.  Throws DetectorException if the X-123 isn't there.
+    void reconnect();
+
 private:
     std::unique_ptr<X123DriverWrap> driver;
     uint16_t local_next_buffer_num;
@@ -63,12 +69,6 @@ private:
 
     void increment_reset_buffering(std::vector<uint8_t> const& status_bytes);
 
-    std::vector<uint32_t>
-    assemble_spectrum(std::span<const uint8_t> buf);
-
-    std::vector<uint32_t>
-    rebin_spectrum(std::vector<uint32_t> const& orig_spectrum);
-
     void upload_ascii_settings(const std::string& ascii);
     void save_debug(
         DetectorMessages::X123Debug::Type const& t,
@@ -81,5 +81,16 @@ private:
     void num_histogram_bins_from_ram();
 };
 
+// 3 little-endian bytes per bin -> counts
+std::vector<uint32_t>
+assemble_spectrum(std::span<const uint8_t> buf);
+
+// Sum bins between the rebin edges in `settings`; unchanged if there
+// are none
+std::vector<uint32_t>
+rebin_spectrum(
+    std::vector<uint32_t> const& orig_spectrum,
+    DetectorMessages::X123Settings const& settings);
+
 } // namespace Detector
 
@@ -12,8 +12,13 @@ X123DriverWrap::X123DriverWrap() :
 { }
 
 X123DriverWrap::X123DriverWrap(size_t n) :
+    X123DriverWrap(nullptr, n)
+{ }
+
+X123DriverWrap::X123DriverWrap(std::shared_ptr<X123Driver::UsbTransport> transport_, size_t n) :
     num_retries_{n > 0? n : 1},
-    cm{nullptr}
+    cm{nullptr},
+    transport{std::move(transport_)}
 {
     reinit();
 }
@@ -23,7 +28,9 @@ X123DriverWrap::~X123DriverWrap() { }
 void X123DriverWrap::reinit() {
     try {
         cm = nullptr;
-        cm = std::make_unique<X123Driver::UsbConnectionManager>();
+        cm = transport
+            ? std::make_unique<X123Driver::UsbConnectionManager>(transport)
+            : std::make_unique<X123Driver::UsbConnectionManager>();
     }
     catch (LibUsbCpp::UsbException const& e) {
         log_warning("USB issue: " + std::string{e.what()});
@@ -92,3 +99,7 @@ void X123DriverWrap::send_recv(
 bool X123DriverWrap::valid() const {
     return cm != nullptr;
 }
+
+void X123DriverWrap::reconnect() {
+    reinit();
+}
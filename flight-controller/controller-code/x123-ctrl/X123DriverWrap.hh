@@ -3,12 +3,15 @@
 #include <memory>
 
 #include "UsbConnectionManager.hh"
+#include "UsbTransport.hh"
 #include "packets/BasePacket.hh"
 #include "packets/responses/Ack.hh"
 
 class X123DriverWrap {
     size_t num_retries_;
     std::unique_ptr<X123Driver::UsbConnectionManager> cm;
+    // null: find the X-123 on the bus
+    std::shared_ptr<X123Driver::UsbTransport> transport;
     void guard_cm();
     void reinit();
 public:
@@ -16,6 +19,8 @@ public:
     ~X123DriverWrap();
 
     X123DriverWrap(size_t n);
+    // talk over `transport` (e.g. a SimulatedX123) instead of libusb
+    X123DriverWrap(std::shared_ptr<X123Driver::UsbTransport> transport, size_t n = 1);
 
     size_t num_retries() const;
     void num_retries(size_t n);
@@ -28,4 +33,7 @@ public:
     void send_recv(X123Driver::Packets::BasePacket&  out, X123Driver::Packets::BasePacket&& in);
 
     bool valid() const;
+
+    // Open a fresh USB connection; valid() says if it worked
+    void reconnect();
 };
@@ -0,0 +1,455 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+#include <SimulatedX123.hh>
+
+namespace X123Driver {
+
+namespace {
+// what the detector sends back; packed like any other packet
+class Reply : public Packets::BasePacket
+{
+	public:
+		Reply(pid_t const& pid, buff_t data) :
+			BasePacket(pid, data.size())
+		{
+			parsed = std::move(data);
+			transferFromParsed();
+		}
+};
+
+uint32_t poisson(std::mt19937& rng, double mean) {
+	return (mean > 0) ? std::poisson_distribution<uint32_t>{mean}(rng) : 0;
+}
+
+void put_u32(uint8_t* dest, uint32_t v) {
+	for (size_t i = 0; i < 4; ++i) {
+		dest[i] = static_cast<uint8_t>(v >> (8 * i));
+	}
+}
+
+std::string trim(std::string const& s) {
+	auto start = s.find_first_not_of(" \t\r\n");
+	if (start == std::string::npos) return "";
+	auto end = s.find_last_not_of(" \t\r\n");
+	return s.substr(start, end - start + 1);
+}
+
+// "A=1; B=2;" -> {{"A", "1"}, {"B", "2"}}; nothing if it's malformed
+std::optional<std::vector<std::pair<std::string, std::string>>>
+split_commands(std::string const& commands) {
+	std::vector<std::pair<std::string, std::string>> ret;
+	std::stringstream ss{commands};
+	std::string cmd;
+	while (std::getline(ss, cmd, ';')) {
+		cmd = trim(cmd);
+		if (cmd.empty()) continue;
+		auto eq = cmd.find('=');
+		if (eq == std::string::npos || eq == 0) {
+			return std::nullopt;
+		}
+		ret.emplace_back(trim(cmd.substr(0, eq)), trim(cmd.substr(eq + 1)));
+	}
+	return ret;
+}
+
+constexpr uint8_t REQ_STATUS = 0x01;
+constexpr uint8_t REQ_SPECTRUM = 0x02;
+constexpr uint8_t REQ_DIAGNOSTIC = 0x03;
+constexpr uint8_t REQ_TEXT = 0x20;
+constexpr uint8_t REQ_CONTROL = 0xf0;
+constexpr uint8_t REQ_COMM_TEST = 0xf1;
+}
+
+SimulatedX123::SimulatedX123(SimulatedX123Config config_) :
+	mtx(),
+	config(std::move(config_)),
+	rng(config.seed),
+	now(clock::duration::zero()),
+	last_wall(clock::now()),
+	next_edge(config.buffer_advance),
+	mca_enabled(true),
+	spectrum(1024),
+	fast_counts(0),
+	slow_counts(0),
+	gp_counter(0),
+	accumulation_ms(0),
+	real_time_ms(0),
+	sequential_running(false),
+	next_buffer(0),
+	buffers(NUM_BUFFERS),
+	text_settings{
+		{"MCAC", "1024"},
+		{"GPED", "RISING"},
+		{"GPGA", "ON"},
+		{"GPIN", "AUX2"},
+		{"GPMC", "ON"},
+		{"GPME", "ON"},
+	},
+	reply(),
+	error_to_inject(0),
+	errors_left(0),
+	counters()
+{ }
+
+void SimulatedX123::advance(clock::duration dt) {
+	std::lock_guard lock{mtx};
+	acquire(now, now + dt);
+	now += dt;
+}
+
+void SimulatedX123::inject_error(int libusb_error, unsigned count) {
+	std::lock_guard lock{mtx};
+	error_to_inject = libusb_error;
+	errors_left = count;
+}
+
+SimulatedX123::Stats SimulatedX123::stats() const {
+	std::lock_guard lock{mtx};
+	return counters;
+}
+
+int SimulatedX123::bulk_transfer(
+	uint8_t endpoint, uint8_t* data, int length,
+	int* transferred, unsigned int)
+{
+	std::lock_guard lock{mtx};
+	if (transferred != nullptr) {
+		*transferred = 0;
+	}
+	if (errors_left > 0) {
+		--errors_left;
+		return error_to_inject;
+	}
+	catch_up();
+
+	if (config.transfer_latency.count() > 0) {
+		std::this_thread::sleep_for(config.transfer_latency);
+	}
+
+	if (endpoint == BULK_OUT_ENDPOINT) {
+		handle_request(data, length);
+		if (transferred != nullptr) {
+			*transferred = length;
+		}
+		return 0;
+	}
+	if (endpoint == BULK_IN_ENDPOINT) {
+		// nothing was asked
+		if (!reply) {
+			return LIBUSB_ERROR_TIMEOUT;
+		}
+		auto out = std::move(*reply);
+		reply.reset();
+		if (out.size() > static_cast<size_t>(length)) {
+			return LIBUSB_ERROR_OVERFLOW;
+		}
+		std::memcpy(data, out.data(), out.size());
+		if (transferred != nullptr) {
+			*transferred = static_cast<int>(out.size());
+		}
+		return 0;
+	}
+	return LIBUSB_ERROR_INVALID_PARAM;
+}
+
+void SimulatedX123::handle_request(uint8_t const* data, int length) {
+	using Packets::BasePacket;
+	++counters.requests;
+	reply.reset();
+
+	// check it the way the detector would
+	auto extra = BasePacket::additionalTransferBytes();
+	if (length < static_cast<int>(extra)
+		|| data[0] != BasePacket::SYNC_1 || data[1] != BasePacket::SYNC_2) {
+		return ack(ACK_SYNC_ERROR);
+	}
+	size_t data_len = (static_cast<size_t>(data[4]) << 8) | data[5];
+	if (data_len + extra != static_cast<size_t>(length)) {
+		return ack(ACK_LEN_ERROR);
+	}
+	uint32_t sum = std::accumulate(data, data + length - BasePacket::CHECKSUM_SZ, uint32_t{0});
+	sum += (data[length - 2] << 8) + data[length - 1];
+	if ((sum & 0xffff) != 0) {
+		return ack(ACK_CHECKSUM_ERROR);
+	}
+
+	pid_t pid{data[2], data[3]};
+	auto payload = data + BasePacket::HEADER_SZ;
+	auto buffer_number = [&]() {
+		return static_cast<uint16_t>((payload[0] << 8) | payload[1]);
+	};
+
+	switch (pid.first) {
+		case REQ_STATUS:
+			if (pid.second == 0x01) {
+				auto st = status();
+				return respond({0x80, 0x01}, buff_t(st.begin(), st.end()));
+			}
+			break;
+
+		case REQ_SPECTRUM:
+			switch (pid.second) {
+				// spectrum + status, then maybe clear
+				case 0x03:
+				case 0x04:
+					respond_spectrum(spectrum, status());
+					if (pid.second == 0x04) {
+						clear_spectrum();
+					}
+					return;
+				// buffer (and clear) spectrum
+				case 0x05:
+				case 0x06: {
+					if (data_len != 2 || buffer_number() >= NUM_BUFFERS) {
+						return ack(ACK_BAD_PARAMETER);
+					}
+					buffers[buffer_number()] = Buffer{spectrum, status()};
+					if (pid.second == 0x06) {
+						clear_spectrum();
+					}
+					return ack(ACK_OK);
+				}
+				// request buffer
+				case 0x07: {
+					if (data_len != 2 || buffer_number() >= NUM_BUFFERS
+						|| !buffers[buffer_number()]) {
+						return ack(ACK_BAD_PARAMETER);
+					}
+					auto const& buf = *buffers[buffer_number()];
+					return respond_spectrum(buf.spectrum, buf.status);
+				}
+			}
+			break;
+
+		case REQ_DIAGNOSTIC:
+			if (pid.second == 0x05) {
+				return respond({0x82, 0x05}, buff_t(256, 0));
+			}
+			break;
+
+		case REQ_TEXT: {
+			std::string text(payload, payload + data_len);
+			switch (pid.second) {
+				case 0x02:
+				case 0x04:
+					return text_configuration(text);
+				case 0x03:
+					return text_readback(text);
+			}
+			break;
+		}
+
+		case REQ_CONTROL:
+			switch (pid.second) {
+				case 0x01:
+					clear_spectrum();
+					return ack(ACK_OK);
+				case 0x02:
+					mca_enabled = true;
+					return ack(ACK_OK);
+				case 0x03:
+					mca_enabled = false;
+					return ack(ACK_OK);
+				case 0x10:
+					gp_counter = 0;
+					return ack(ACK_OK);
+				case 0x1e:
+					// hardware-controlled sequential buffering, from buffer 0
+					std::fill(buffers.begin(), buffers.end(), std::nullopt);
+					next_buffer = 0;
+					sequential_running = true;
+					return ack(ACK_OK);
+				case 0x1f:
+					sequential_running = false;
+					return ack(ACK_OK);
+			}
+			break;
+
+		case REQ_COMM_TEST:
+			if (pid.second == 0x00) {
+				return ack(ACK_OK);
+			}
+			break;
+	}
+	ack(ACK_UNRECOGNIZED);
+}
+
+void SimulatedX123::respond(pid_t pid, buff_t data) {
+	Reply r{pid, std::move(data)};
+	reply = r.transferBuffer();
+}
+
+void SimulatedX123::ack(uint8_t code) {
+	if (code != ACK_OK) {
+		++counters.error_acks;
+	}
+	respond({0xff, code}, {});
+}
+
+void SimulatedX123::respond_spectrum(std::vector<uint32_t> const& spec, Status const& st) {
+	// 3 little-endian bytes per bin, then the status
+	buff_t data(3 * spec.size() + st.size());
+	for (size_t i = 0; i < spec.size(); ++i) {
+		data[3*i] = static_cast<uint8_t>(spec[i]);
+		data[3*i + 1] = static_cast<uint8_t>(spec[i] >> 8);
+		data[3*i + 2] = static_cast<uint8_t>(spec[i] >> 16);
+	}
+	std::copy(st.begin(), st.end(), data.begin() + 3 * spec.size());
+
+	// 256 bins -> 0x02, 512 -> 0x04, ...
+	auto pid2 = static_cast<uint8_t>(2 * (std::bit_width(spec.size()) - 9) + 2);
+	respond({0x81, pid2}, std::move(data));
+}
+
+void SimulatedX123::text_configuration(std::string const& commands) {
+	auto parsed = split_commands(commands);
+	if (!parsed) {
+		return ack(ACK_BAD_PARAMETER);
+	}
+	for (auto const& [key, value] : *parsed) {
+		if (key == "MCAC") {
+			static constexpr std::array<size_t, 6> ALLOWED{256, 512, 1024, 2048, 4096, 8192};
+			size_t bins = 0;
+			try { bins = std::stoul(value); } catch (std::exception const&) { }
+			if (std::find(ALLOWED.begin(), ALLOWED.end(), bins) == ALLOWED.end()) {
+				return ack(ACK_BAD_PARAMETER);
+			}
+			spectrum.assign(bins, 0);
+		}
+		text_settings[key] = value;
+	}
+	ack(ACK_OK);
+}
+
+void SimulatedX123::text_readback(std::string const& queries) {
+	auto parsed = split_commands(queries);
+	if (!parsed) {
+		return ack(ACK_BAD_PARAMETER);
+	}
+	std::string out;
+	for (auto const& [key, _] : *parsed) {
+		auto it = text_settings.find(key);
+		if (it == text_settings.end()) {
+			return ack(ACK_BAD_PARAMETER);
+		}
+		out += key + "=" + it->second + ";";
+	}
+	respond({0x82, 0x07}, buff_t(out.begin(), out.end()));
+}
+
+SimulatedX123::Status SimulatedX123::status() const {
+	// see the Amptek programmer's guide, and X123Control::generate_health
+	Status st{};
+	put_u32(&st[0], fast_counts);
+	put_u32(&st[4], slow_counts);
+	put_u32(&st[8], gp_counter);
+	auto acc = static_cast<uint32_t>(accumulation_ms);
+	st[12] = static_cast<uint8_t>(acc % 100);
+	st[13] = static_cast<uint8_t>(acc / 100);
+	st[14] = static_cast<uint8_t>(acc / 100 >> 8);
+	st[15] = static_cast<uint8_t>(acc / 100 >> 16);
+	put_u32(&st[20], static_cast<uint32_t>(real_time_ms));
+
+	// high voltage, 0.5 V per count: 130 V
+	int16_t hv = 260;
+	st[30] = static_cast<uint8_t>(hv >> 8);
+	st[31] = static_cast<uint8_t>(hv);
+	// detector temperature, 0.1 K per count: 220 K
+	uint16_t det_temp = 2200;
+	st[32] = static_cast<uint8_t>((det_temp >> 8) & 0xf);
+	st[33] = static_cast<uint8_t>(det_temp);
+	// board temperature, deg C
+	st[34] = 30;
+
+	// sequential buffering: bit 0 is bit 8 of the next buffer number,
+	// bit 1 says it's running.  Only nine bits, so once all 512 buffers
+	// are full the number reads as 0.
+	st[46] = static_cast<uint8_t>(((next_buffer >> 8) & 0x1) | (sequential_running ? 0x2 : 0));
+	st[47] = static_cast<uint8_t>(next_buffer & 0xff);
+	return st;
+}
+
+void SimulatedX123::catch_up() {
+	if (config.manual_clock) {
+		return;
+	}
+	auto wall = clock::now();
+	auto dt = wall - last_wall;
+	last_wall = wall;
+	acquire(now, now + dt);
+	now += dt;
+}
+
+void SimulatedX123::acquire(clock::duration from, clock::duration to) {
+	while (next_edge <= to) {
+		accumulate(next_edge - from);
+		aux2_edge();
+		from = next_edge;
+		next_edge += config.buffer_advance;
+	}
+	accumulate(to - from);
+}
+
+void SimulatedX123::accumulate(clock::duration dt) {
+	double ms = std::chrono::duration<double, std::milli>(dt).count();
+	real_time_ms += ms;
+	if (!mca_enabled || ms <= 0) {
+		return;
+	}
+	accumulation_ms += ms;
+
+	auto n = poisson(rng, config.count_rate * ms / 1000);
+	for (uint32_t i = 0; i < n; ++i) {
+		++spectrum[sample_bin()];
+	}
+	slow_counts += n;
+	// some pulses only make it past the fast channel
+	fast_counts += n + n / 10;
+	counters.counts += n;
+}
+
+void SimulatedX123::aux2_edge() {
+	// GPIN=AUX2: the counter sees every edge
+	++gp_counter;
+	if (!sequential_running) {
+		return;
+	}
+
+	buffers[next_buffer] = Buffer{spectrum, status()};
+	++next_buffer;
+	++counters.buffers_filled;
+	clear_spectrum();
+	if (next_buffer >= NUM_BUFFERS) {
+		// out of room; stays stopped until restarted
+		sequential_running = false;
+	}
+}
+
+void SimulatedX123::clear_spectrum() {
+	std::fill(spectrum.begin(), spectrum.end(), 0);
+	fast_counts = 0;
+	slow_counts = 0;
+	accumulation_ms = 0;
+}
+
+uint16_t SimulatedX123::sample_bin() {
+	// a continuum with one line on top
+	double bins = static_cast<double>(spectrum.size());
+	std::bernoulli_distribution in_line{0.3};
+	double b;
+	if (in_line(rng)) {
+		b = std::normal_distribution<double>{0.4 * bins, bins / 100}(rng);
+	}
+	else {
+		b = std::exponential_distribution<double>{6 / bins}(rng);
+	}
+	return static_cast<uint16_t>(std::clamp(b, 0.0, bins - 1));
+}
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <UsbTransport.hh>
+#include <packets/BasePacket.hh>
+
+namespace X123Driver
+{
+
+struct SimulatedX123Config {
+	// counts per second going into the spectrum while the MCA is enabled
+	double count_rate = 1000;
+	// time between AUX2 rising edges (the GPS PPS in flight); each one
+	// advances hardware-controlled sequential buffering
+	std::chrono::milliseconds buffer_advance{1000};
+	uint32_t seed = 1;
+	// Only let time pass in advance(), instead of following the wall
+	// clock.  Makes tests repeatable.
+	bool manual_clock = false;
+	// added to every transfer, like the real USB round trip
+	std::chrono::microseconds transfer_latency{0};
+};
+
+/*
+ * An Amptek X-123 in software, for tests and benchmarks.
+ *
+ * It checks the sync bytes, length and checksum of each request the
+ * way the detector does, and answers with a packet of its own (or an
+ * ACK) that UsbConnectionManager can receive.  Understood:
+ *   - Status, SpectrumPlusStatus(+Clear), DiagnosticData
+ *   - text configuration to RAM/NVRAM and readback (MCAC sets the
+ *     number of bins; other commands are only remembered)
+ *   - MCA enable/disable, clear spectrum, clear GP counter, comm test
+ *   - sequential buffering: BufferSpectrum(+Clear), RequestBuffer, and
+ *     the hardware-controlled kind started by RestartSequentialBuffering,
+ *     where every AUX2 edge moves the spectrum into the next of 512
+ *     buffers and clears it.  The next buffer number and whether
+ *     buffering is running are in Status bytes 46 and 47.
+ */
+class SimulatedX123 : public UsbTransport
+{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		explicit SimulatedX123(SimulatedX123Config config = {});
+
+		int bulk_transfer(
+			uint8_t endpoint, uint8_t* data, int length,
+			int* transferred, unsigned int timeout_ms) override;
+
+		// With manual_clock: let `dt` go by
+		void advance(clock::duration dt);
+
+		// Fail the next `count` transfers with `libusb_error`
+		void inject_error(int libusb_error, unsigned count = 1);
+
+		struct Stats {
+			uint64_t requests = 0;
+			// ACKs saying something was wrong with a request
+			uint64_t error_acks = 0;
+			uint64_t counts = 0;
+			// by hardware-controlled sequential buffering
+			uint64_t buffers_filled = 0;
+		};
+		Stats stats() const;
+
+		static constexpr uint16_t NUM_BUFFERS = 512;
+		static constexpr size_t STATUS_SIZE = 64;
+
+		// ACK codes (second PID byte); see Responses::Ack
+		enum AckCode : uint8_t {
+			ACK_OK = 0,
+			ACK_SYNC_ERROR = 1,
+			ACK_LEN_ERROR = 3,
+			ACK_CHECKSUM_ERROR = 4,
+			ACK_BAD_PARAMETER = 5,
+			ACK_UNRECOGNIZED = 7,
+		};
+
+	private:
+		using buff_t = Packets::BasePacket::buff_t;
+		using pid_t = Packets::BasePacket::pid_t;
+		using Status = std::array<uint8_t, STATUS_SIZE>;
+
+		struct Buffer {
+			std::vector<uint32_t> spectrum;
+			Status status;
+		};
+
+		mutable std::mutex mtx;
+		SimulatedX123Config config;
+		std::mt19937 rng;
+
+		// time since power on, and when it was last caught up
+		clock::duration now;
+		clock::time_point last_wall;
+		clock::duration next_edge;
+
+		bool mca_enabled;
+		std::vector<uint32_t> spectrum;
+		uint32_t fast_counts;
+		uint32_t slow_counts;
+		uint32_t gp_counter;
+		double accumulation_ms;
+		double real_time_ms;
+
+		bool sequential_running;
+		uint16_t next_buffer;
+		std::vector<std::optional<Buffer>> buffers;
+
+		std::map<std::string, std::string> text_settings;
+
+		// what goes back on the next IN transfer
+		std::optional<buff_t> reply;
+
+		int error_to_inject;
+		unsigned errors_left;
+		Stats counters;
+
+		void catch_up();
+		void acquire(clock::duration from, clock::duration to);
+		void accumulate(clock::duration dt);
+		void aux2_edge();
+		void clear_spectrum();
+		uint16_t sample_bin();
+
+		void handle_request(uint8_t const* data, int length);
+		void respond(pid_t pid, buff_t data);
+		void ack(uint8_t code);
+		void respond_spectrum(std::vector<uint32_t> const& spec, Status const& status);
+		void text_configuration(std::string const& commands);
+		void text_readback(std::string const& queries);
+		Status status() const;
+};
+
+}
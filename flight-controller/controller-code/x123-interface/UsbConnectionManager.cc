@@ -10,26 +10,27 @@ UsbConnectionManager::UsbConnectionManager() {
 	connect();
 }
 
+UsbConnectionManager::UsbConnectionManager(std::shared_ptr<UsbTransport> transport_) :
+	transport(std::move(transport_))
+{ }
+
 void UsbConnectionManager::connect()
 {
 	auto ctx = std::make_shared<LibUsbCpp::Context>();
 
-	static const int AMPTEK_PRODUCT_ID = 0x842a;
-	static const int AMPTEK_VENDOR_ID = 0x10c4;
 	auto handle = libusb_open_device_with_vid_pid(ctx->handle, AMPTEK_VENDOR_ID, AMPTEK_PRODUCT_ID);
 
-	device_handle = std::make_shared<LibUsbCpp::DeviceHandle>(handle, ctx);
+	auto device_handle = std::make_shared<LibUsbCpp::DeviceHandle>(handle, ctx);
 	device_handle->claim_interface(AMPTEK_DETECTOR_INTERFACE);
+	transport = std::make_shared<LibUsbTransport>(device_handle);
 }
 
 void UsbConnectionManager::send(Packets::BasePacket& p)
 {
 	// prepare to send
 	p.transferFromParsed();
-	static const uint8_t BULK_OUT_ENDPOINT = 0x02;
-	int rc = libusb_bulk_transfer(
-		device_handle->handle,
-		BULK_OUT_ENDPOINT,
+	int rc = transport->bulk_transfer(
+		UsbTransport::BULK_OUT_ENDPOINT,
 		p.transferPointer(),
 		p.transferSize(),
 		nullptr,
@@ -44,13 +45,11 @@ void UsbConnectionManager::send(Packets::BasePacket& p)
 
 void UsbConnectionManager::receive(Packets::BasePacket& p)
 {
-	static const uint8_t BULK_IN_ENDPOINT = 0x81;
 	constexpr size_t MAX_SIZE = 32800;
 	std::vector<uint8_t> transfer(MAX_SIZE);
 	int transferred{0};
-	int rc = libusb_bulk_transfer(
-		device_handle->handle,
-		BULK_IN_ENDPOINT,
+	int rc = transport->bulk_transfer(
+		UsbTransport::BULK_IN_ENDPOINT,
 		transfer.data(),
 		transfer.size(),
 		&transferred,
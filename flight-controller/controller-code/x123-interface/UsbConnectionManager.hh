@@ -1,6 +1,7 @@
 #pragma once
 
 #include <LibUsbCpp.hh>
+#include <UsbTransport.hh>
 #include <packets/BasePacket.hh>
 
 namespace X123Driver
@@ -10,10 +11,14 @@ class UsbConnectionManager
 {
 	public:
 		UsbConnectionManager();
+		// e.g. a SimulatedX123
+		explicit UsbConnectionManager(std::shared_ptr<UsbTransport> transport);
 
 		void sendAndReceive(Packets::BasePacket& out, Packets::BasePacket& in);
 
 		static const int AMPTEK_DETECTOR_INTERFACE = 0;
+		static constexpr int AMPTEK_PRODUCT_ID = 0x842a;
+		static constexpr int AMPTEK_VENDOR_ID = 0x10c4;
 	private:
 
 		// these should always be used as a pair. so they're private
@@ -22,7 +27,7 @@ class UsbConnectionManager
 
 		void connect();
 
-		std::shared_ptr<LibUsbCpp::DeviceHandle> device_handle;
+		std::shared_ptr<UsbTransport> transport;
 
 		// long enough for diagnostic packet
 		static const int USB_TIMEOUT_MS = 5000;
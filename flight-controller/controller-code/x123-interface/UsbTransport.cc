@@ -0,0 +1,17 @@
+#include <UsbTransport.hh>
+
+namespace X123Driver {
+
+LibUsbTransport::LibUsbTransport(std::shared_ptr<LibUsbCpp::DeviceHandle> device_handle_) :
+	device_handle(std::move(device_handle_))
+{ }
+
+int LibUsbTransport::bulk_transfer(
+	uint8_t endpoint, uint8_t* data, int length,
+	int* transferred, unsigned int timeout_ms)
+{
+	return libusb_bulk_transfer(
+		device_handle->handle, endpoint, data, length, transferred, timeout_ms);
+}
+
+}
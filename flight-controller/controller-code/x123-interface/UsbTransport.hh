@@ -0,0 +1,43 @@
+#pragma once
+
+#include <memory>
+
+#include <LibUsbCpp.hh>
+
+namespace X123Driver
+{
+
+/*
+ * How UsbConnectionManager reaches the X-123: bulk transfers of whole
+ * Amptek packets.  LibUsbTransport is the real detector; SimulatedX123
+ * stands in for it in tests and benchmarks.
+ */
+class UsbTransport
+{
+	public:
+		virtual ~UsbTransport() = default;
+
+		// Like libusb_bulk_transfer: 0, or a negative libusb error code.
+		// `transferred` may be null on the way out.
+		virtual int bulk_transfer(
+			uint8_t endpoint, uint8_t* data, int length,
+			int* transferred, unsigned int timeout_ms) = 0;
+
+		static const uint8_t BULK_OUT_ENDPOINT = 0x02;
+		static const uint8_t BULK_IN_ENDPOINT = 0x81;
+};
+
+class LibUsbTransport : public UsbTransport
+{
+	public:
+		explicit LibUsbTransport(std::shared_ptr<LibUsbCpp::DeviceHandle> device_handle);
+
+		int bulk_transfer(
+			uint8_t endpoint, uint8_t* data, int length,
+			int* transferred, unsigned int timeout_ms) override;
+
+	private:
+		std::shared_ptr<LibUsbCpp::DeviceHandle> device_handle;
+};
+
+}
@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <numeric>
+
+#include <SimulatedX123.hh>
+#include <UsbConnectionManager.hh>
+#include <packets/requests/SequentialBuffering.hh>
+#include <packets/requests/TextConfiguration.hh>
+#include <packets/requests/ZeroLengthPackets.hh>
+#include <packets/responses/Ack.hh>
+#include <packets/responses/Spectrum.hh>
+#include <packets/responses/Status.hh>
+#include <packets/responses/TextConfigurationReadback.hh>
+
+using namespace std::chrono_literals;
+using namespace X123Driver;
+namespace req = Packets::Requests;
+namespace res = Packets::Responses;
+
+namespace {
+struct Sim {
+    std::shared_ptr<SimulatedX123> x123;
+    UsbConnectionManager cm;
+
+    explicit Sim(SimulatedX123Config config = {.manual_clock = true}) :
+        x123{std::make_shared<SimulatedX123>(std::move(config))},
+        cm{x123}
+    { }
+
+    // next buffer number and whether hardware buffering is running
+    std::pair<uint16_t, bool> sequential_state() {
+        req::Status st_req;
+        res::Status st;
+        cm.sendAndReceive(st_req, st);
+        auto const& buf = st.parsedBuffer();
+        return {
+            static_cast<uint16_t>(((buf[46] & 0x1) << 8) | buf[47]),
+            static_cast<bool>(buf[46] & 0x2)
+        };
+    }
+};
+
+uint32_t total_counts(res::BaseSpectrum const& spec) {
+    auto const& buf = spec.parsedBuffer();
+    uint32_t total = 0;
+    for (size_t i = 0; i < spec.num_bins(); ++i) {
+        total += buf[3*i] | (buf[3*i + 1] << 8) | (buf[3*i + 2] << 16);
+    }
+    return total;
+}
+
+uint32_t slow_counts(res::BaseSpectrum const& spec) {
+    auto const& buf = spec.parsedBuffer();
+    auto st = buf.data() + 3 * spec.num_bins();
+    return st[4] | (st[5] << 8) | (st[6] << 16) | (st[7] << 24);
+}
+}
+
+TEST(SimulatedX123, StatusAndAck) {
+    Sim sim;
+    req::Status status_req;
+    res::Status status;
+    EXPECT_NO_THROW(sim.cm.sendAndReceive(status_req, status));
+
+    req::CommTestAck ping;
+    res::Ack ack;
+    EXPECT_NO_THROW(sim.cm.sendAndReceive(ping, ack));
+    EXPECT_EQ(sim.x123->stats().error_acks, 0u);
+}
+
+TEST(SimulatedX123, BadChecksumIsAcked) {
+    SimulatedX123 x123{{.manual_clock = true}};
+    req::Status p;
+    p.transferFromParsed();
+    auto bytes = p.transferBuffer();
+    bytes.back() ^= 0xff;
+    ASSERT_EQ(x123.bulk_transfer(
+        UsbTransport::BULK_OUT_ENDPOINT, bytes.data(), bytes.size(), nullptr, 0), 0);
+
+    std::vector<uint8_t> reply(64);
+    int got = 0;
+    ASSERT_EQ(x123.bulk_transfer(
+        UsbTransport::BULK_IN_ENDPOINT, reply.data(), reply.size(), &got, 0), 0);
+    ASSERT_EQ(got, 8);
+    EXPECT_EQ(reply[2], 0xff);
+    EXPECT_EQ(reply[3], SimulatedX123::ACK_CHECKSUM_ERROR);
+    EXPECT_EQ(x123.stats().error_acks, 1u);
+}
+
+TEST(SimulatedX123, TextConfigurationReadsBack) {
+    Sim sim;
+    req::TextConfigurationToRam set{"MCAC=2048;GAIN=20.5"};
+    res::Ack ack;
+    sim.cm.sendAndReceive(set, ack);
+
+    req::TextConfigurationReadback rb_req{"MCAC=;GAIN=;"};
+    res::TextConfigurationReadback rb;
+    sim.cm.sendAndReceive(rb_req, rb);
+    auto const& buf = rb.parsedBuffer();
+    std::string reply{buf.begin(), buf.begin() + std::string_view{"MCAC=2048;GAIN=20.5;"}.size()};
+    EXPECT_EQ(reply, "MCAC=2048;GAIN=20.5;");
+
+    // the spectrum follows the number of bins
+    req::SpectrumPlusStatus spec_req;
+    res::Spectrum2048 spec;
+    EXPECT_NO_THROW(sim.cm.sendAndReceive(spec_req, spec));
+
+    // unknown commands are refused
+    req::TextConfigurationReadback bad{"NOPE=;"};
+    EXPECT_THROW(sim.cm.sendAndReceive(bad, rb), Packets::AckError);
+}
+
+TEST(SimulatedX123, SpectrumMatchesStatus) {
+    Sim sim{{.count_rate = 5000, .manual_clock = true}};
+    sim.x123->advance(500ms);
+
+    req::SpectrumPlusStatusClear spec_req;
+    res::Spectrum1024 spec;
+    sim.cm.sendAndReceive(spec_req, spec);
+    EXPECT_NEAR(total_counts(spec), 2500, 300);
+    EXPECT_EQ(total_counts(spec), slow_counts(spec));
+
+    // and it was cleared
+    req::SpectrumPlusStatus again_req;
+    sim.cm.sendAndReceive(again_req, spec);
+    EXPECT_EQ(total_counts(spec), 0u);
+}
+
+TEST(SimulatedX123, HardwareSequentialBuffering) {
+    Sim sim{{.count_rate = 2000, .buffer_advance = 1000ms, .manual_clock = true}};
+    res::Ack ack;
+    req::RestartSequentialBuffering restart;
+    sim.cm.sendAndReceive(restart, ack);
+
+    EXPECT_EQ(sim.sequential_state(), std::make_pair(uint16_t{0}, true));
+    sim.x123->advance(3500ms);
+    EXPECT_EQ(sim.sequential_state(), std::make_pair(uint16_t{3}, true));
+    EXPECT_EQ(sim.x123->stats().buffers_filled, 3u);
+
+    for (uint16_t i = 0; i < 3; ++i) {
+        req::RequestBuffer rb{i};
+        res::Spectrum1024 spec;
+        sim.cm.sendAndReceive(rb, spec);
+        // one second's worth, cleared in between
+        EXPECT_NEAR(total_counts(spec), 2000, 250);
+        EXPECT_EQ(total_counts(spec), slow_counts(spec));
+    }
+
+    // not filled yet
+    req::RequestBuffer future{3};
+    res::Spectrum1024 spec;
+    EXPECT_THROW(sim.cm.sendAndReceive(future, spec), Packets::AckError);
+
+    // stops by itself once every buffer is used; 512 is too big for
+    // the nine bits in the status, so it reads as 0
+    sim.x123->advance(600s);
+    EXPECT_EQ(sim.sequential_state(), std::make_pair(uint16_t{0}, false));
+    EXPECT_EQ(sim.x123->stats().buffers_filled, SimulatedX123::NUM_BUFFERS);
+
+    req::CancelSequentialBuffering cancel;
+    sim.cm.sendAndReceive(cancel, ack);
+    sim.cm.sendAndReceive(restart, ack);
+    EXPECT_EQ(sim.sequential_state(), std::make_pair(uint16_t{0}, true));
+}
+
+TEST(SimulatedX123, InjectedErrorsThrow) {
+    Sim sim;
+    sim.x123->inject_error(LIBUSB_ERROR_NO_DEVICE);
+    req::Status status_req;
+    res::Status status;
+    EXPECT_THROW(sim.cm.sendAndReceive(status_req, status), LibUsbCpp::UsbException);
+    EXPECT_NO_THROW(sim.cm.sendAndReceive(status_req, status));
+}
+
+int main(int argc, char *argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -48,6 +48,11 @@ def read_det_health(fn: str, open_func: Callable) -> list[ies.DetectorHealth]:
 
 
 def read_hafx_sci(fn: str, open_func: Callable) -> list[ies.NominalHafx]:
+    """Reads either time slice format; compact slices are widened."""
+    with open_func(fn, "rb") as f:
+        first = f.read(1)
+    if first and first[0] == ies.COMPACT_HAFX_VERSION_1:
+        return [c.to_nominal() for c in read_binary(fn, ies.CompactHafx, open_func)]
     return read_binary(fn, ies.NominalHafx, open_func)
 
 
@@ -53,6 +53,48 @@ class NominalHafx(ctypes.Structure):
         }
 
 
+HafxCompactHistogramArray = NUM_HG_BINS * ctypes.c_uint16
+# first byte of every CompactHafx; never a channel number
+COMPACT_HAFX_VERSION_1 = 0x81
+
+
+class CompactHafx(ctypes.Structure):
+    """NominalHafx at the 16-bit widths the board uses
+    (HafxCompactSpectrumStatus on the C++ side)."""
+
+    # do not pad the struct
+    _pack_ = 1
+    _fields_ = [
+        ("version", ctypes.c_uint8),
+        ("ch", ctypes.c_uint8),
+        ("buffer_number", ctypes.c_uint16),
+        ("num_evts", ctypes.c_uint16),
+        ("num_triggers", ctypes.c_uint16),
+        ("dead_time", ctypes.c_uint16),
+        ("anode_current", ctypes.c_uint16),
+        ("histogram", HafxCompactHistogramArray),
+        ("time_anchor", ctypes.c_uint32),
+        ("missed_pps", ctypes.c_bool),
+        ("slices_lost", ctypes.c_bool),
+    ]
+
+    def to_nominal(self) -> NominalHafx:
+        """Widen to a NominalHafx, so it works anywhere one does."""
+        ret = NominalHafx()
+        for name, _ in NominalHafx._fields_:
+            if name == "histogram":
+                ret.histogram = HafxHistogramArray(*self.histogram)
+            else:
+                setattr(ret, name, getattr(self, name))
+        return ret
+
+    def to_json(self):
+        ret = self.to_nominal().to_json()
+        ret["version"] = {"value": self.version, "unit": "N/A"}
+        ret["slices_lost"] = {"value": bool(self.slices_lost), "unit": "N/A"}
+        return ret
+
+
 class HafxHealth(ctypes.Structure):
     # no struct padding
     _pack_ = 1